@@ -1,11 +1,14 @@
 #include <iostream>
 #include "depends/SEAL/native/src/seal/seal.h"
 #include "ringsnark/zk_proof_systems/rinocchio/rinocchio.hpp"
+#include "ringsnark/zk_proof_systems/rinocchio/key_cache.hpp"
 #include "depends/SEAL-Polytools/include/poly_arith.h"
 #include "ringsnark/seal/seal_ring.hpp"
 #include "ringsnark/gadgetlib/protoboard.hpp"
+#include "ringsnark/Circuit_tools/OpL_passes.h"
 #include <vector>
 #include <map>
+#include <optional>
 #include <boost/algorithm/string/trim.hpp>
 #include <string>
 #include <stack>
@@ -82,7 +85,6 @@ public:
         // BatchEncoder *zkp_encoder = getZKPEncoder(*zkp_context);
         /// Initializing the Ring element and the Encoding element for ZKP.
         R::set_context(*zkp_context);
-        E::set_context();
         /// Creating the secret, public, and relinearization keys for HE.
         KeyGenerator keygen(*he_context);
         secretKey = keygen.secret_key();
@@ -155,10 +157,21 @@ public:
     /**
      * Creates Rinnochhio key pair object.
      * @param pb a protoboard object that holds the R1CS constraint.
+     * @param num_threads the number of threads used to encode the keys.
+     * @param key_cache_dir if not empty, a directory of keys from earlier runs, which is searched before
+     * generating the keys, and which the generated keys are added to.
      * @return keypair an object has the proving and verification keys.
      * */
-    RincKeys get_Rinocchio_keys(const ringsnark::protoboard<R> &pb) {
-        const auto keypair = ringsnark::rinocchio::generator<R, E>(pb.get_constraint_system());
+    RincKeys get_Rinocchio_keys(const ringsnark::protoboard<R> &pb, size_t num_threads = 1,
+                                const std::string &key_cache_dir = "") {
+        /// The encoding parameters are chosen for the size of the circuit.
+        ringsnark::rinocchio::set_encoding_context<R, E>(pb.get_constraint_system());
+        if (!key_cache_dir.empty()) {
+            return ringsnark::rinocchio::cached_generator<R, E>(key_cache_dir, pb.get_constraint_system(), false,
+                                                                false, false, num_threads);
+        }
+        const auto keypair = ringsnark::rinocchio::generator<R, E>(pb.get_constraint_system(), false, false, false,
+                                                                   num_threads);
         return keypair;
     }
 
@@ -218,6 +231,10 @@ private:
     bool verified = false;
     /// A boolean variable to check if the circuit has been created before excution or not.
     bool circuit_created = false;
+    /// Whether create_circuit folded the linear operations into the constraints of the multiplications that use
+    /// them. The ZKP values of additions, subtractions and negations are then plain sums and differences, instead of
+    /// products with the "one" value.
+    bool linear_ops_folded = false;
     /// The number of variables being used within the circuit.
     int vars_count;
     /// A vector holding the ciphertext involved in the computations
@@ -230,6 +247,18 @@ private:
     vector<::polytools::SealPoly> polys;
     /// A vector of RingElem objects for Rinocchio
     vector<ringsnark::seal::RingElem> values;
+    /// For each index, its value if it is a constant known when creating the circuit. Constants are reduced modulo
+    /// the HE plaintext modulus, and are never encrypted.
+    vector<std::optional<int64_t>> consts;
+    /// The HE plaintexts of the constants, for multiply_plain and add_plain.
+    vector<Plaintext> plains;
+    /// Whether execute relinearizes a ciphertext only if it is multiplied by another one later, or is the result, and
+    /// switches the ciphertexts to lower levels as their multiplicative depth grows.
+    bool lazy_he = false;
+    /// For each instruction, whether its result is relinearized, if lazy_he is set.
+    vector<char> relin_res;
+    /// For each instruction, the chain index its result is switched down to, if lazy_he is set.
+    vector<size_t> res_levels;
     /// A 2D vector holding the instructions (operations) to be executed by the circuit.
     /// The first dimension holds vectors of operations.
     /// The second dimension is a vector that holds the operation code (opcode) and the its parameters.
@@ -264,15 +293,27 @@ private:
      * @param op1_indx the index of the first ciphertext.
      * @param op2_indx the index of the second ciphertext.
      * @param res_indx the index at which to store the result.
+     * @param pool the memory pool for the temporary values of HE.
      * */
-    void mul_(int op1_indx, int op2_indx, int res_indx) {
+    void mul_(int op1_indx, int op2_indx, int res_indx, MemoryPoolHandle pool = MemoryManager::GetPool()) {
         //        uint64_t op1 = vs[op1_indx];
         //        uint64_t op2 = vs[op2_indx];
         //        vs[res_indx] = op1 * op2;
         /// For HE
-        evaluator->multiply(ciphers[op1_indx], ciphers[op2_indx], ciphers[res_indx]);
-        evaluator->relinearize_inplace(ciphers[res_indx], relinKeys);
-        //evaluator->mod_switch_to_next_inplace(ciphers[res_indx]);
+        if (consts[op1_indx] || consts[op2_indx]) {
+            // Multiplying by a plaintext constant needs no relinearization.
+            const int const_indx = consts[op1_indx] ? op1_indx : op2_indx;
+            const int cipher_indx = consts[op1_indx] ? op2_indx : op1_indx;
+            evaluator->multiply_plain(ciphers[cipher_indx], plains[const_indx], ciphers[res_indx], pool);
+        } else {
+            const Ciphertext *op1 = &ciphers[op1_indx], *op2 = &ciphers[op2_indx];
+            Ciphertext tmp;
+            align_levels_(op1, op2, tmp, pool);
+            evaluator->multiply(*op1, *op2, ciphers[res_indx], pool);
+            if (!lazy_he) {
+                evaluator->relinearize_inplace(ciphers[res_indx], relinKeys, pool);
+            }
+        }
         /// For ZKP
         auto poly = ::polytools::SealPoly(polys[op1_indx]);
         poly.multiply_inplace(polys[op2_indx]);
@@ -287,18 +328,31 @@ private:
      * @param op2_indx the index of the second ciphertext.
      * @param one_indx the index of the value 1 to be multiplied by the result of the addition operation.
      * @param res_indx the index at which to store the result.
+     * @param pool the memory pool for the temporary values of HE.
      * */
-    void add_(int op1_indx, int op2_indx, int one_indx, int res_indx) {
+    void add_(int op1_indx, int op2_indx, int one_indx, int res_indx,
+              MemoryPoolHandle pool = MemoryManager::GetPool()) {
         // vs[res_indx] = vs[op1_indx] + vs[op2_indx];
         //  For HE
-        evaluator->add(ciphers[op1_indx], ciphers[op2_indx], ciphers[res_indx]);
+        if (consts[op1_indx]) {
+            evaluator->add_plain(ciphers[op2_indx], plains[op1_indx], ciphers[res_indx]);
+        } else if (consts[op2_indx]) {
+            evaluator->add_plain(ciphers[op1_indx], plains[op2_indx], ciphers[res_indx]);
+        } else {
+            const Ciphertext *op1 = &ciphers[op1_indx], *op2 = &ciphers[op2_indx];
+            Ciphertext tmp;
+            align_levels_(op1, op2, tmp, pool);
+            evaluator->add(*op1, *op2, ciphers[res_indx]);
+        }
         /*Cancel relineraizing after additions*/
         //evaluator->relinearize_inplace(ciphers[res_indx], relinKeys);
 
         // For ZKP
         auto poly = ::polytools::SealPoly(polys[op1_indx]);
         poly.add_inplace(polys[op2_indx]);
-        poly.multiply_inplace(polys[one_indx]);
+        if (!linear_ops_folded) {
+            poly.multiply_inplace(polys[one_indx]);
+        }
 
         polys[res_indx] = poly;
         values[res_indx] = ringsnark::seal::RingElem(poly);
@@ -326,6 +380,24 @@ private:
         // cout << "def:\t" << vs[indx] << endl;
     }
 
+    /**
+     * Store the plaintext and the ZKP value of a constant, which must be set in consts.
+     * @param indx the index of the constant.
+     * */
+    void def_const_(int indx) {
+        const int64_t val = *consts[indx];
+        /// For HE, the constant polynomial, i.e., the constant in every slot if batching is enabled.
+        const uint64_t t = he_context->first_context_data()->parms().plain_modulus().value();
+        plains[indx].resize(1);
+        plains[indx][0] = val < 0 ? t - static_cast<uint64_t>(-val) : static_cast<uint64_t>(val);
+        /// For ZKP
+        const auto value = const_elem_(val);
+        auto poly = value;
+        poly.to_poly_inplace();
+        polys[indx] = poly.get_poly();
+        values[indx] = value;
+    }
+
     /**
      * Negate a ciphertext.
      * @param indx the indx of the ciphertext to be negated.
@@ -337,7 +409,11 @@ private:
         evaluator->negate(ciphers[indx], ciphers[res_indx]);
 
         auto poly = ::polytools::SealPoly(polys[indx]);
-        poly.multiply_inplace(polys[neg_one_indx]);
+        if (linear_ops_folded) {
+            poly.negate_inplace();
+        } else {
+            poly.multiply_inplace(polys[neg_one_indx]);
+        }
         polys[res_indx] = poly;
         values[res_indx] = ringsnark::seal::RingElem(poly);
     }
@@ -348,13 +424,27 @@ private:
      * @param op2_indx the index of the second ciphertext.
      * @param one_indx the index of the value 1 to be multiplied by the result of the addition operation.
      * @param res_indx the index at which to store the result.
+     * @param pool the memory pool for the temporary values of HE.
      * */
-    void subtract_(int op1_indx, int op2_indx, int one_indx, int res_indx) {
-        evaluator->sub(ciphers[op1_indx], ciphers[op2_indx], ciphers[res_indx]);
+    void subtract_(int op1_indx, int op2_indx, int one_indx, int res_indx,
+                   MemoryPoolHandle pool = MemoryManager::GetPool()) {
+        if (consts[op1_indx]) {
+            evaluator->negate(ciphers[op2_indx], ciphers[res_indx]);
+            evaluator->add_plain_inplace(ciphers[res_indx], plains[op1_indx]);
+        } else if (consts[op2_indx]) {
+            evaluator->sub_plain(ciphers[op1_indx], plains[op2_indx], ciphers[res_indx]);
+        } else {
+            const Ciphertext *op1 = &ciphers[op1_indx], *op2 = &ciphers[op2_indx];
+            Ciphertext tmp;
+            align_levels_(op1, op2, tmp, pool);
+            evaluator->sub(*op1, *op2, ciphers[res_indx]);
+        }
 
         auto poly = ::polytools::SealPoly(polys[op1_indx]);
         poly.subtract_inplace(polys[op2_indx]);
-        poly.multiply_inplace(polys[one_indx]);
+        if (!linear_ops_folded) {
+            poly.multiply_inplace(polys[one_indx]);
+        }
         polys[res_indx] = poly;
         values[res_indx] = ringsnark::seal::RingElem(poly);
     }
@@ -374,6 +464,121 @@ private:
             exit(2);
         }
         ciphers[lhs_indx] = ciphers[rhs_indx];
+        // The ZKP value is used by the next operations, whereas the variable of lhs_indx keeps its first value, as
+        // the constraints created before the assignment use it.
+        polys[lhs_indx] = polys[rhs_indx];
+    }
+
+    /**
+     * The ring element of a constant, for the ZKP values and the coefficients of the R1CS constraints.
+     * @param val the constant.
+     * @return a scalar, or its negation if val is negative.
+     * */
+    static ringsnark::seal::RingElem const_elem_(int64_t val) {
+        ringsnark::seal::RingElem elem(static_cast<uint64_t>(val < 0 ? -val : val));
+        if (val < 0) {
+            elem.negate_inplace();
+        }
+        return elem;
+    }
+
+    /**
+     * Track the constants through an instruction, with opl::fold_consts.
+     * @param inst an instruction of the execution list.
+     * @return true if the result of the instruction is a constant, which is then set in consts.
+     * */
+    bool fold_consts_(const vector<int> &inst) {
+        return opl::fold_consts(inst, consts, he_context->first_context_data()->parms().plain_modulus().value());
+    }
+
+    /**
+     * Make op1 and op2 point to ciphertexts at the same level, by switching the one at the higher level down into tmp.
+     * @param op1 the first ciphertext.
+     * @param op2 the second ciphertext.
+     * @param tmp the ciphertext to store the switched one.
+     * @param pool the memory pool for the temporary values of HE.
+     * */
+    void align_levels_(const Ciphertext *&op1, const Ciphertext *&op2, Ciphertext &tmp,
+                       MemoryPoolHandle pool) const {
+        const size_t level1 = he_context->get_context_data(op1->parms_id())->chain_index();
+        const size_t level2 = he_context->get_context_data(op2->parms_id())->chain_index();
+        if (level1 > level2) {
+            evaluator->mod_switch_to(*op1, op2->parms_id(), tmp, pool);
+            op1 = &tmp;
+        } else if (level2 > level1) {
+            evaluator->mod_switch_to(*op2, op1->parms_id(), tmp, pool);
+            op2 = &tmp;
+        }
+    }
+
+    /**
+     * Switch the result of an instruction down to its planned level, and relinearize it if planned, for lazy_he.
+     * @param indx the index of the result.
+     * @param inst_indx the index of the instruction in the execution list.
+     * @param pool the memory pool for the temporary values of HE.
+     * */
+    void lazy_he_finish_(int indx, size_t inst_indx, MemoryPoolHandle pool) {
+        auto &cipher = ciphers[indx];
+        // Switching first makes the relinearization cheaper, as it runs on fewer RNS limbs.
+        while (he_context->get_context_data(cipher.parms_id())->chain_index() > res_levels[inst_indx]) {
+            evaluator->mod_switch_to_next_inplace(cipher, pool);
+        }
+        if (relin_res[inst_indx] && cipher.size() > 2) {
+            evaluator->relinearize_inplace(cipher, relinKeys, pool);
+        }
+    }
+
+    /**
+     * Execute an instruction.
+     * @param inst an instruction of the execution list.
+     * @param inst_indx the index of the instruction in the execution list.
+     * @param folded whether fold_consts_ found the result of the instruction to be a constant.
+     * @param vars_vals a map of char-Ciphertext pair representing the ciphertext value of a previously
+     *          defined variable.
+     * @param pool the memory pool for the temporary values of HE.
+     * */
+    void execute_(const vector<int> &inst, size_t inst_indx, bool folded, const map<char, Ciphertext> &vars_vals,
+                  MemoryPoolHandle pool) {
+        // get the instruction code
+        int opcode = inst[0];
+        // if it is 0, then it's a value definition operation. Like operations on constants only, it is
+        // computed without HE.
+        if (folded) { // def_val
+            def_const_(opl::res_indx_of(inst));
+        }
+            // if it is 1, then it is a multiplication operation
+        else if (opcode == 1) { // mul
+            mul_(inst[1], inst[2], inst[3], pool);
+        }
+            // if it is 2, then it is a summation operation
+        else if (opcode == 2) { // def_var
+            char var = char(inst[1]);
+            auto it = vars_vals.find(var);
+            auto val = it != vars_vals.end() ? it->second : Ciphertext();
+            int indx = inst[2];
+            def_val_(val, indx);
+        }
+            // if it is 3, then it is an add operation
+        else if (opcode == 3) { // add
+            add_(inst[1], inst[2], inst[3], inst[4], pool);
+        }
+            // if it is 4, then it is negation operation
+        else if (opcode == 4) {
+            negate_(inst[1], inst[2], inst[3]);
+        } else if (opcode == 5) {
+            subtract_(inst[1], inst[2], inst[3], inst[4], pool);
+        } else if (opcode == 6) {
+            assign_(inst[1], inst[2], inst[3]);
+        } else if (opcode == 7){
+//            eq_(inst[1], inst[2], inst[3]);
+//            res_indx = inst[1];
+        }
+        else {
+            cout << "Unrecognized opcode >> " << opcode << endl;
+        }
+        if (lazy_he && !folded && (opcode == 1 || (opcode >= 3 && opcode <= 6))) {
+            lazy_he_finish_(opl::res_indx_of(inst), inst_indx, pool);
+        }
     }
 
     /**
@@ -417,17 +622,25 @@ public:
      * Establish the circuit defined by the user.
      * @param exec_list a 2D vector includes the operations and their operands to be executed.
      * @param in_ciphers a vector of Ciphertext includes user's defined encrypted constants.
+     * @param fold_linear_ops if set, only multiplications become constraints: additions, subtractions, negations
+     * and assignments are folded into the linear combinations of the multiplications that use them, and of the
+     * result. Otherwise, every operation becomes a constraint, with linear ones multiplied by the "one" value.
+     * In both cases, the constants defined by def_val are coefficients of the constraints rather than variables,
+     * and the operations on constants only are computed here.
      * @return pb the R1CS constraints.
      * */
-    ringsnark::protoboard<R> create_circuit(vector<vector<int>> exec_list, vector<Ciphertext> &in_ciphers) {
+    ringsnark::protoboard<R> create_circuit(vector<vector<int>> exec_list, vector<Ciphertext> &in_ciphers,
+                                            bool fold_linear_ops = true) {
+        linear_ops_folded = fold_linear_ops;
         /// the vectors size is the number of operations defined by exec_list + the constants defined by the user.
         this->n = exec_list.size() + in_ciphers.size();
         /// Setup vars vector for verifying the computations executed by the circuit.
-        ringsnark::pb_variable_array<R> tmp_vars(n, ringsnark::pb_variable<R>());
+        /// vars[i] holds the first value stored at index i, and vars[n] the result.
+        ringsnark::pb_variable_array<R> tmp_vars(n + 1, ringsnark::pb_variable<R>());
         vars = tmp_vars;
-        vars.allocate(pb, n, "x");
+        vars.allocate(pb, n + 1, "x");
         /// Set the input size of the circuit.
-        pb.set_input_sizes(n - 1); // vars[n-1] is private, all other values are public
+        pb.set_input_sizes(n); // vars[n] is private, all other values are public
         const size_t N = zkp_context->get_context_data(zkp_context->first_parms_id())->parms().poly_modulus_degree();
 
         /// A vector of plain values involved in the computation
@@ -444,23 +657,45 @@ public:
         /// A vector of RingElem used in Rinocchio
         vector<ringsnark::seal::RingElem> tmp_values(n);
         values = tmp_values;
+        /// The constants, which are set by fold_consts_ while creating and executing the circuit.
+        consts.assign(n, std::nullopt);
+        plains.assign(n, Plaintext());
 
         /// Register user's defined constants within the ciphers vector.
         setInput_(in_ciphers);
 
+        /// The linear combination of circuit variables held by each index. Linear operations only combine these,
+        /// and the multiplications that use them are constrained on the combinations.
+        vector<ringsnark::linear_combination<R>> lcs(vars.begin(), vars.end());
+        /// The index of the result, i.e., the last value computed.
+        int out_indx = -1;
+
         // Loop over the execution list.
         for (int i = 0; i < exec_list.size(); ++i) {
             vector<int> inst = exec_list[i]; // get an instruction
             int opcode = inst[0];            // the opcode is the first element in the instruction vector.
-            if (opcode == 0) { // def_val -- do nothing.
-                continue;
+            if (fold_consts_(inst)) { // def_val, or an operation on constants only -- no constraint.
+                int res_indx = opl::res_indx_of(inst);
+                lcs[res_indx] = ringsnark::linear_combination<R>(const_elem_(*consts[res_indx]));
+                if (opcode != 0) {
+                    out_indx = res_indx;
+                }
             } else if (opcode == 1) {                           // mul
                 int op1_indx = inst[1]; // read the index of op1.
                 int op2_indx = inst[2]; // read the index of op2.
                 int res_indx = inst[3]; // read the index of the result.
-                // Register the R1CS constraint.
-                pb.add_r1cs_constraint(ringsnark::r1cs_constraint<R>(vars[op1_indx], vars[op2_indx],
-                                                                     vars[res_indx]));
+                if (fold_linear_ops && (consts[op1_indx] || consts[op2_indx])) {
+                    // Multiplying by a constant is linear.
+                    const int const_indx = consts[op1_indx] ? op1_indx : op2_indx;
+                    const int var_indx = consts[op1_indx] ? op2_indx : op1_indx;
+                    lcs[res_indx] = lcs[var_indx] * const_elem_(*consts[const_indx]);
+                } else {
+                    // Register the R1CS constraint.
+                    pb.add_r1cs_constraint(ringsnark::r1cs_constraint<R>(lcs[op1_indx], lcs[op2_indx],
+                                                                         vars[res_indx]));
+                    lcs[res_indx] = vars[res_indx];
+                }
+                out_indx = res_indx;
             } else if (opcode == 2) { // def_var -- do nothing.
                 continue;
             } else if (opcode == 3) {                           // add
@@ -468,26 +703,45 @@ public:
                 int op2_indx = inst[2]; // read the index of op2.
                 int one_indx = inst[3]; // read the index of 1 value.
                 int res_indx = inst[4]; // read the index of the result.
-                // Register the R1CS constraint.
-                pb.add_r1cs_constraint(ringsnark::r1cs_constraint<R>(vars[op1_indx] + vars[op2_indx],
-                                                                     vars[one_indx], vars[res_indx]));
+                if (fold_linear_ops) {
+                    lcs[res_indx] = lcs[op1_indx] + lcs[op2_indx];
+                } else {
+                    // Register the R1CS constraint.
+                    pb.add_r1cs_constraint(ringsnark::r1cs_constraint<R>(lcs[op1_indx] + lcs[op2_indx],
+                                                                         vars[one_indx], vars[res_indx]));
+                    lcs[res_indx] = vars[res_indx];
+                }
+                out_indx = res_indx;
             } else if (opcode == 4) {                               // negate
                 int indx = inst[1];         // read the index of the value to be negated.
                 int neg_one_indx = inst[2]; // read the index of -1
                 int res_indx = inst[3];     // read the index of the result
                 // ringsnark::seal::RingElem::one().negate_inplace();
-                //  Register the R1CS constraint.
-                pb.add_r1cs_constraint(ringsnark::r1cs_constraint<R>(vars[indx], vars[neg_one_indx],
-                                                                     vars[res_indx]));
+                if (fold_linear_ops) {
+                    lcs[res_indx] = -lcs[indx];
+                } else {
+                    //  Register the R1CS constraint.
+                    pb.add_r1cs_constraint(ringsnark::r1cs_constraint<R>(lcs[indx], vars[neg_one_indx],
+                                                                         vars[res_indx]));
+                    lcs[res_indx] = vars[res_indx];
+                }
+                out_indx = res_indx;
             } else if (opcode == 5) {   //subtract
                 int op1_indx = inst[1];
                 int op2_indx = inst[2];
                 int one_indx = inst[3];
                 int res_indx = inst[4];
-                pb.add_r1cs_constraint(ringsnark::r1cs_constraint<R>(vars[op1_indx] - vars[op2_indx], vars[one_indx],
-                                                                     vars[res_indx]));
-            } else if (opcode == 6) { // assignment
-                continue;
+                if (fold_linear_ops) {
+                    lcs[res_indx] = lcs[op1_indx] - lcs[op2_indx];
+                } else {
+                    pb.add_r1cs_constraint(ringsnark::r1cs_constraint<R>(lcs[op1_indx] - lcs[op2_indx],
+                                                                         vars[one_indx], vars[res_indx]));
+                    lcs[res_indx] = vars[res_indx];
+                }
+                out_indx = res_indx;
+            } else if (opcode == 6) { // assignment -- the left-hand side becomes an alias, without a constraint.
+                lcs[inst[1]] = lcs[inst[2]];
+                out_indx = inst[1];
             } else if (opcode == 7){
                 int op1_indx = inst[1];
                 int op2_indx = inst[2];
@@ -497,6 +751,12 @@ public:
                 cout << "Unrecognized opcode >> " << opcode << endl;
             }
         }
+        /// If the result is not the variable of its index, e.g., it is computed by linear operations, is a constant,
+        /// or is assigned, bind it to vars[n] with a single constraint. Its index may be reassigned after being used,
+        /// so vars[out_indx] can hold another value.
+        if (out_indx >= 0 && !(lcs[out_indx] == vars[out_indx])) {
+            pb.add_r1cs_constraint(ringsnark::r1cs_constraint<R>(lcs[out_indx], 1, vars[n]));
+        }
         circuit_created = true;
 
         return pb;
@@ -527,7 +787,12 @@ public:
         exec_lst.push_back(instruction);
     }
 
-    [[deprecated]] void def_val(int val, int indx) {
+    /**
+     * Define a plaintext constant within the circuit (e.g., r2 := 3).
+     * @param val the value of the constant.
+     * @param indx the index at which the constant will be stored.
+     * */
+    void def_val(int val, int indx) {
         // operation, val, indx, -1
         vector<int> instruction{0, val, indx, -1};
         exec_lst.push_back(instruction);
@@ -621,60 +886,45 @@ public:
     }
 
     /**
-     * Execute the current circuit.
+     * Execute the current circuit. The instructions run concurrently with opl::run_scheduled, each one as soon as
+     * the ones it depends on are done.
      * @param exec_list a 2D vector representing the operations to be executed by the circuit.
      * @param vars_vals a map of char-Ciphertext pair representing the ciphertext value of a previously
      *          defined variable.
+     * @param num_threads the number of threads running the instructions.
+     * @param lazy if set, relinearize and switch the levels of the ciphertexts as planned by opl::plan_lazy_he,
+     *          instead of relinearizing every product and keeping all ciphertexts at the first level.
      * */
-    void execute(const vector<vector<int>> &exec_list, map<char, Ciphertext> vars_vals) {
+    void execute(const vector<vector<int>> &exec_list, const map<char, Ciphertext> &vars_vals,
+                 size_t num_threads = 1, bool lazy = false) {
         if (circuit_created) {
-            // Loop over each instruction in the list.
-            for (auto inst: exec_list) {
-                // get an instruction
-                // get the instruction code
-                int opcode = inst[0];
-                // if it is 0, then it's a value definition operation.
-                if (opcode == 0) { // def_val
-                    // def_val_(inst[1], inst[2]);
-                }
-                    // if it is 1, then it is a multiplication operation
-                else if (opcode == 1) { // mul
-                    mul_(inst[1], inst[2], inst[3]);
-                    res_indx = inst[3];
-                }
-                    // if it is 2, then it is a summation operation
-                else if (opcode == 2) { // def_var
-                    char var = char(inst[1]);
-                    auto val = vars_vals[var];
-                    int indx = inst[2];
-                    def_val_(val, indx);
-                }
-                    // if it is 3, then it is an add operation
-                else if (opcode == 3) { // add
-                    add_(inst[1], inst[2], inst[3], inst[4]);
-                    res_indx = inst[4];
-                }
-                    // if it is 4, then it is negation operation
-                else if (opcode == 4) {
-                    negate_(inst[1], inst[2], inst[3]);
-                    res_indx = inst[3];
-                } else if (opcode == 5) {
-                    subtract_(inst[1], inst[2], inst[3], inst[4]);
-                    res_indx = inst[4];
-                } else if (opcode == 6) {
-                    assign_(inst[1], inst[2], inst[3]);
-                    res_indx = inst[1];
-                } else if (opcode == 7){
-//                    eq_(inst[1], inst[2], inst[3]);
-//                    res_indx = inst[1];
-                }
-                else {
-                    cout << "Unrecognized opcode >> " << opcode << endl;
+            /// The constants are tracked again from the start.
+            consts.assign(n, std::nullopt);
+            lazy_he = lazy;
+            const uint64_t plain_modulus = he_context->first_context_data()->parms().plain_modulus().value();
+            if (lazy_he) {
+                opl::plan_lazy_he(exec_list, n, plain_modulus, he_context->first_context_data()->chain_index(),
+                                  relin_res, res_levels);
+            }
+            // The result is the last value computed in the order of the execution list.
+            for (const auto &inst: exec_list) {
+                if (inst[0] == 1 || (inst[0] >= 3 && inst[0] <= 6)) {
+                    res_indx = opl::res_indx_of(inst);
                 }
             }
+            /// A memory pool per thread, so that the threads do not contend for the global one of SEAL.
+            vector<MemoryPoolHandle> pools(num_threads);
+            for (auto &pool: pools) {
+                pool = MemoryPoolHandle::New();
+            }
+            opl::run_scheduled(exec_list, n, num_threads, consts, plain_modulus,
+                               [&](size_t i, bool folded, size_t t) {
+                                   execute_(exec_list[i], i, folded, vars_vals, pools[t]);
+                               });
             for (size_t i = 0; i < n; i++) {
                 pb.val(vars[i]) = values[i];
             }
+            pb.val(vars[n]) = ringsnark::seal::RingElem(polys[res_indx]);
         } else {
             cout << "The circuit is not created!" << endl;
             exit(1);
@@ -688,6 +938,11 @@ public:
         if (verified) {
             cout << "R1CS satisfied: " << std::boolalpha << pb.is_satisfied() << endl;
             // TODO
+            if (consts[res_indx]) {
+                // The result does not depend on the encrypted values, so it was never encrypted.
+                cout << "Constant result= " << *consts[res_indx] << endl << endl;
+                return;
+            }
             Plaintext plain_res;
             auto ctxt = ciphers[res_indx];
             decryptor->decrypt(ctxt, plain_res);
@@ -713,12 +968,14 @@ public:
     /**
      * Generate a proof for the execution of the circuit.
      * @param pk the proving key for Rinocchio.
+     * @param num_threads the number of threads used by the prover.
      * */
-    RincProof prove(const RincPb &pk) {
+    RincProof prove(const RincPb &pk, size_t num_threads = 1) {
         cout << "\n=== Generating Proof ===" << endl;
         auto proof = ringsnark::rinocchio::prover(pk,
                                                   pb.primary_input(),
-                                                  pb.auxiliary_input());
+                                                  pb.auxiliary_input(),
+                                                  num_threads);
         //cout << "Size of proof:\t" << proof.size_in_bits() << " bits" << endl;
         return proof;
     }
@@ -727,10 +984,11 @@ public:
      * Verify the generated proof.
      * @param vk the verification key.
      * @param proof the generated proof.
+     * @param num_threads the number of threads used to decode the proof.
      * */
-    void verify(const RincVk &vk, const RincProof &proof) {
+    void verify(const RincVk &vk, const RincProof &proof, size_t num_threads = 1) {
         cout << "\n=== Verifying ===" << endl;
-        const bool verif = ringsnark::rinocchio::verifier(vk, pb.primary_input(), proof);
+        const bool verif = ringsnark::rinocchio::verifier(vk, pb.primary_input(), proof, num_threads);
         cout << "Verification passed: " << std::boolalpha << verif << endl;
         verified = verif;
     }
@@ -895,9 +1153,23 @@ int main(int argc, char *argv[]) {
                                                    *initializer.getEncryptor());
             }
         }
+        size_t num_threads = 1;
+        if (cmdOptionExists(argv, argv + argc, "-t")) {
+            num_threads = std::max(1ul, stoul(getCmdOption(argv, argv + argc, "-t")));
+        }
+        std::string key_cache_dir;
+        if (cmdOptionExists(argv, argv + argc, "-k")) {
+            key_cache_dir = getCmdOption(argv, argv + argc, "-k");
+        }
+        /// Encrypt the constants of the OpL file like variables, unless they should be used as plaintexts.
+        const bool encrypt_consts = !cmdOptionExists(argv, argv + argc, "-p");
+        /// Relinearize only before multiplications, and switch the moduli by multiplicative depth.
+        const bool lazy_he = cmdOptionExists(argv, argv + argc, "-l");
+        /// Rebalance the chains of multiplications and additions to lower the depth of the circuit.
+        const bool rebalance = cmdOptionExists(argv, argv + argc, "-b");
         if (cmdOptionExists(argv, argv + argc, "-h")) {
             cout
-                    << "./[filename] -f [OpL file] -v variable_name1=value,variable_name2=value,variable_name3=value,...\n\n";
+                    << "./[filename] -f [OpL file] -v variable_name1=value,variable_name2=value,variable_name3=value,... [-t number of key generation/execution/prover/verifier threads, default 1] [-k key cache directory] [-p use the constants as plaintexts instead of encrypting them] [-l lazy relinearization and modulus switching] [-b rebalance multiplication and addition chains]\n\n";
             cout
                     << "*** NOTE ***\n1)The variable name must be ONLY one char (e.g., x, y, z)\n2)There is NO space between the variable name, the equal sign, and the value (e.g., y=5)\n3)Variable names must be same as the ones in the parsed IR file\n";
             exit(0);
@@ -954,9 +1226,11 @@ int main(int argc, char *argv[]) {
                 }
             } else if (vec.size() == 3) { /// This is either a variable or a constant declaration
                 string op1 = vec[2];
-                if (is_number(op1)) { /// define a constant
+                if (is_number(op1) && encrypt_consts) { /// define an encrypted constant
                     def_const(stoi(op1), stoi(res_indx), ctxt,
                               *circuit.getHeEncoder(), *initializer.getEncryptor());
+                } else if (is_number(op1)) { /// define a plaintext constant
+                    circuit.def_val(stoi(op1), stoi(res_indx));
                 } else if (op1[0] == 'r') {
                     //circuit.mul(stoi(op1.substr(1)), ONE_INDX, stoi(res_indx));
                     circuit.assign(stoi(res_indx), stoi(op1.substr(1)), ONE_INDX);
@@ -970,25 +1244,30 @@ int main(int argc, char *argv[]) {
         circuit.print_circuit();
 
         vector<vector<int>> exec_lst = circuit.get_exec_list();
+        cout << "Multiplicative depth= " << opl::multiplicative_depth(exec_lst) << endl;
+        if (rebalance) {
+            exec_lst = opl::rebalance(exec_lst);
+            cout << "Multiplicative depth after rebalancing= " << opl::multiplicative_depth(exec_lst) << endl;
+        }
 
         auto start_create_cir_r1cs = std::chrono::system_clock::now();
         ringsnark::protoboard<R> pb = circuit.create_circuit(exec_lst, ctxt);
         auto end_create_cir_r1cs = std::chrono::system_clock::now();
 
         auto start_rinc_keys = std::chrono::system_clock::now();
-        const auto keypair = initializer.get_Rinocchio_keys(pb);
+        const auto keypair = initializer.get_Rinocchio_keys(pb, num_threads, key_cache_dir);
         auto end_rinc_keys = std::chrono::system_clock::now();
 
         auto start_circ_exec = std::chrono::system_clock::now();
-        circuit.execute(exec_lst, vars_vals);
+        circuit.execute(exec_lst, vars_vals, num_threads, lazy_he);
         auto end_circ_exec = std::chrono::system_clock::now();
 
         auto start_prove = std::chrono::system_clock::now();
-        auto proof = circuit.prove(keypair.pk);
+        auto proof = circuit.prove(keypair.pk, num_threads);
         auto end_prove = std::chrono::system_clock::now();
 
         auto start_verify = std::chrono::system_clock::now();
-        circuit.verify(keypair.vk, proof);
+        circuit.verify(keypair.vk, proof, num_threads);
         auto end_verify = std::chrono::system_clock::now();
 
         auto start_decrypt = std::chrono::system_clock::now();
@@ -149,7 +149,8 @@ bool SealPoly::is_zero() const
     auto mm = data.begin();
     size_t size = data.size();
     // Check if first item is zero, then use memcmp() to check remaining size-1 items
-    return (*mm == 0) && !memcmp(mm, mm + 1, size - 1);
+    // Note: memcmp() takes a byte count; upstream passes the element count and so only looks at the first 1/8 of data
+    return (*mm == 0) && !memcmp(mm, mm + 1, (size - 1) * sizeof(*mm));
 }
 
 bool SealPoly::is_equal(const SealPoly &other) const
@@ -158,7 +159,8 @@ bool SealPoly::is_equal(const SealPoly &other) const
     {
         return false;
     }
-    return !memcmp(data.begin(), other.data.begin(), data.size());
+    // Byte count, not element count (see is_zero)
+    return !memcmp(data.begin(), other.data.begin(), data.size() * sizeof(*data.begin()));
 }
 
 void SealPoly::multiply_scalar_inplace(uint64_t scalar)
@@ -414,4 +414,22 @@ TEST_F(FHETest, IsEqual)
 
     equal = x.is_equal(y);
     EXPECT_EQ(equal, false);
-}
\ No newline at end of file
+}
+TEST_F(FHETest, IsZeroAndIsEqualCompareAllCoefficients)
+{
+    // Regression test: is_zero() and is_equal() used to pass element counts to memcmp(),
+    // so polynomials that only differ in the last 7/8 of their coefficients compared equal
+    auto first_parms = context.first_context_data()->parms();
+    size_t size = first_parms.poly_modulus_degree() * first_parms.coeff_modulus().size();
+    std::vector<uint64_t> zeros(size, 0);
+    std::vector<uint64_t> last(size, 0);
+    last[size - 1] = 1;
+
+    polytools::SealPoly zero(context, zeros, &context.first_parms_id());
+    polytools::SealPoly x(context, last, &context.first_parms_id());
+
+    EXPECT_EQ(zero.is_zero(), true);
+    EXPECT_EQ(x.is_zero(), false);
+    EXPECT_EQ(x.is_equal(zero), false);
+    EXPECT_EQ(zero.is_equal(x), false);
+}
@@ -0,0 +1,532 @@
+#ifndef RINGSNARK_OPL_PASSES_H
+#define RINGSNARK_OPL_PASSES_H
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+/**
+ * The passes on OpL execution lists shared by the drivers: constant folding, multiplicative depth, rebalancing,
+ * concurrent execution, and the lazy relinearization plan. An instruction is a vector holding its opcode followed
+ * by its operands: def_val (0), mul (1), def_var (2), add (3), negate (4), subtract (5), assign (6) and eq (7).
+ * */
+namespace opl {
+
+    /**
+     * Returns the index at which an instruction stores its result, or -1 if it does not store one.
+     * @param inst an instruction of the execution list.
+     * */
+    inline int res_indx_of(const std::vector<int> &inst) {
+        switch (inst[0]) {
+            case 0: // def_val
+            case 2: // def_var
+                return inst[2];
+            case 1: // mul
+            case 4: // negate
+                return inst[3];
+            case 3: // add
+            case 5: // subtract
+                return inst[4];
+            case 6: // assign
+                return inst[1];
+            default:
+                return -1;
+        }
+    }
+
+    /**
+     * Returns the indices an instruction reads, including the index of 1 or -1 if it has one.
+     * @param inst an instruction of the execution list.
+     * */
+    inline std::vector<int> operands_of(const std::vector<int> &inst) {
+        switch (inst[0]) {
+            case 1: // mul
+            case 4: // negate
+                return {inst[1], inst[2]};
+            case 3: // add
+            case 5: // subtract
+                return {inst[1], inst[2], inst[3]};
+            case 6: // assign
+                return {inst[2]};
+            default:
+                return {};
+        }
+    }
+
+    /**
+     * Returns the number of indices used by the execution list, i.e., the largest index plus one.
+     * @param exec_list a 2D vector representing the operations to be executed by the circuit.
+     * */
+    inline size_t num_indices(const std::vector<std::vector<int>> &exec_list) {
+        int num = 0;
+        for (const auto &inst: exec_list) {
+            for (int op: operands_of(inst)) {
+                num = std::max(num, op + 1);
+            }
+            num = std::max(num, res_indx_of(inst) + 1);
+        }
+        return num;
+    }
+
+    /**
+     * Reduce a constant modulo the HE plaintext modulus, to the range (-t/2, t/2].
+     * @param val the constant.
+     * @param plain_modulus the HE plaintext modulus t.
+     * @return the reduced constant.
+     * */
+    inline int64_t reduce_const(__int128 val, uint64_t plain_modulus) {
+        const auto t = static_cast<__int128>(plain_modulus);
+        val %= t;
+        if (val < 0) {
+            val += t;
+        }
+        if (val > t / 2) {
+            val -= t;
+        }
+        return static_cast<int64_t>(val);
+    }
+
+    /**
+     * Track the constants through an instruction. Its result is a constant if all of its operands are, or if it
+     * multiplies by zero, and it is then computed when creating the circuit instead of being executed.
+     * @param inst an instruction of the execution list.
+     * @param consts for each index, its value if it is a constant, reduced by reduce_const.
+     * @param plain_modulus the HE plaintext modulus.
+     * @return true if the result of the instruction is a constant, which is then set in consts.
+     * */
+    inline bool fold_consts(const std::vector<int> &inst, std::vector<std::optional<int64_t>> &consts,
+                            uint64_t plain_modulus) {
+        const int indx = res_indx_of(inst);
+        if (indx < 0) {
+            return false;
+        }
+        std::optional<int64_t> res;
+        const int opcode = inst[0];
+        if (opcode == 0) { // def_val
+            res = reduce_const(inst[1], plain_modulus);
+        } else if (opcode == 1) { // mul
+            const auto op1 = consts[inst[1]], op2 = consts[inst[2]];
+            if (op1 && op2) {
+                res = reduce_const(static_cast<__int128>(*op1) * *op2, plain_modulus);
+            } else if ((op1 && *op1 == 0) || (op2 && *op2 == 0)) {
+                res = 0;
+            }
+        } else if (opcode == 3 || opcode == 5) { // add, subtract
+            const auto op1 = consts[inst[1]], op2 = consts[inst[2]];
+            if (op1 && op2) {
+                res = reduce_const(opcode == 3 ? static_cast<__int128>(*op1) + *op2
+                                               : static_cast<__int128>(*op1) - *op2, plain_modulus);
+            }
+        } else if (opcode == 4) { // negate
+            if (consts[inst[1]]) {
+                res = reduce_const(-static_cast<__int128>(*consts[inst[1]]), plain_modulus);
+            }
+        } else if (opcode == 6) { // assign
+            res = consts[inst[2]];
+        }
+        consts[indx] = res;
+        return res.has_value();
+    }
+
+    /**
+     * The depth of a value: the number of multiplications of two ciphertexts and the number of operations on the
+     * longest paths to it, and whether it is a constant.
+     * */
+    struct DepthInfo {
+        size_t depth = 0;
+        size_t height = 0;
+        bool is_const = false;
+
+        bool operator<(const DepthInfo &other) const {
+            return std::tie(depth, height) < std::tie(other.depth, other.height);
+        }
+    };
+
+    /**
+     * Update the depths of the indices with an instruction.
+     * @param inst an instruction of the execution list.
+     * @param info the depth of each index, where the inputs have the default DepthInfo.
+     * */
+    inline void track_depth(const std::vector<int> &inst, std::vector<DepthInfo> &info) {
+        const int opcode = inst[0];
+        const int indx = res_indx_of(inst);
+        if (indx < 0) {
+            return;
+        }
+        DepthInfo res;
+        if (opcode == 0) { // def_val
+            res.is_const = true;
+        } else if (opcode != 2) { // not def_var
+            // The operands holding values, i.e., without the index of 1 or -1.
+            std::vector<int> ops{inst[opcode == 6 ? 2 : 1]};
+            if (opcode == 1 || opcode == 3 || opcode == 5) {
+                ops.push_back(inst[2]);
+            }
+            res.is_const = true;
+            for (int op: ops) {
+                res.depth = std::max(res.depth, info[op].depth);
+                res.height = std::max(res.height, info[op].height);
+                res.is_const = res.is_const && info[op].is_const;
+            }
+            if (opcode == 1 && !info[inst[1]].is_const && !info[inst[2]].is_const) {
+                res.depth++;
+            }
+            if (opcode != 6) {
+                res.height++;
+            }
+        }
+        info[indx] = res;
+    }
+
+    /**
+     * Returns the multiplicative depth of an execution list, i.e., the largest number of multiplications of two
+     * ciphertexts on a path of the circuit. Multiplications by constants are not counted.
+     * @param exec_list a 2D vector representing the operations to be executed by the circuit.
+     * */
+    inline size_t multiplicative_depth(const std::vector<std::vector<int>> &exec_list) {
+        std::vector<DepthInfo> info(num_indices(exec_list));
+        size_t depth = 0;
+        for (const auto &inst: exec_list) {
+            track_depth(inst, info);
+            const int indx = res_indx_of(inst);
+            if (indx >= 0) {
+                depth = std::max(depth, info[indx].depth);
+            }
+        }
+        return depth;
+    }
+
+    /**
+     * Rebalance the chains of multiplications and of additions of an execution list into trees of lowest depth.
+     * A chain is a tree of the same operation whose inner results are only used by the next operation of the tree,
+     * and whose indices are written once. It is rebuilt where its last operation was, by repeatedly combining its two
+     * operands of lowest depth, and reusing the indices of its inner results. Chains whose operands are written again
+     * before the last operation are left as they are.
+     * @param exec_list a 2D vector representing the operations to be executed by the circuit.
+     * @return the rebalanced execution list, which computes the same values and has the same size.
+     * */
+    inline std::vector<std::vector<int>> rebalance(const std::vector<std::vector<int>> &exec_list) {
+        const size_t m = exec_list.size();
+        const size_t num = num_indices(exec_list);
+        /// The instructions using the result of each instruction, the instructions whose results the operands of
+        /// each instruction are, and the positions at which each index is written.
+        std::vector<std::vector<size_t>> users(m);
+        std::vector<std::array<int, 2>> producers(m, {-1, -1});
+        std::vector<std::vector<size_t>> writes(num);
+        std::vector<int> writer(num, -1);
+        int out = -1;
+        for (size_t i = 0; i < m; ++i) {
+            const auto &inst = exec_list[i];
+            for (int op: operands_of(inst)) {
+                if (writer[op] >= 0) {
+                    users[writer[op]].push_back(i);
+                }
+            }
+            if (inst[0] == 1 || inst[0] == 3) {
+                producers[i] = {writer[inst[1]], writer[inst[2]]};
+            }
+            const int indx = res_indx_of(inst);
+            if (indx >= 0) {
+                writes[indx].push_back(i);
+                writer[indx] = int(i);
+            }
+            if (inst[0] == 1 || (inst[0] >= 3 && inst[0] <= 6)) {
+                out = int(i);
+            }
+        }
+        // Whether an instruction is inside a chain, i.e., only the next operation of the chain uses its result.
+        auto chained = [&](size_t i) {
+            const auto &inst = exec_list[i];
+            if ((inst[0] != 1 && inst[0] != 3) || users[i].size() != 1 || int(i) == out ||
+                writes[res_indx_of(inst)].size() != 1) {
+                return false;
+            }
+            const auto &user = exec_list[users[i][0]];
+            return user[0] == inst[0] && (inst[0] == 1 || user[3] == inst[3]);
+        };
+
+        /// The inner instructions of the rebalanced chains, and the operands and inner instructions of the chain
+        /// ending at each instruction.
+        std::vector<char> inner(m, false);
+        std::vector<std::vector<int>> chain_ops(m);
+        std::vector<std::vector<size_t>> chain_inners(m);
+        for (size_t root = 0; root < m; ++root) {
+            if ((exec_list[root][0] != 1 && exec_list[root][0] != 3) || chained(root)) {
+                continue;
+            }
+            std::vector<size_t> inners, stack{root};
+            std::vector<int> ops;
+            bool valid = true;
+            while (!stack.empty()) {
+                const size_t i = stack.back();
+                stack.pop_back();
+                for (int k = 0; k < 2; ++k) {
+                    const int p = producers[i][k];
+                    if (p >= 0 && chained(p)) {
+                        inners.push_back(p);
+                        stack.push_back(p);
+                        continue;
+                    }
+                    // The operand must still hold the same value where the chain is rebuilt.
+                    const int op = exec_list[i][1 + k];
+                    const auto next_write = std::upper_bound(writes[op].begin(), writes[op].end(), i);
+                    valid = valid && (next_write == writes[op].end() || *next_write >= root);
+                    ops.push_back(op);
+                }
+            }
+            if (valid && ops.size() > 2) {
+                for (size_t i: inners) {
+                    inner[i] = true;
+                }
+                std::sort(inners.begin(), inners.end());
+                chain_ops[root] = ops;
+                chain_inners[root] = inners;
+            }
+        }
+
+        std::vector<std::vector<int>> res;
+        res.reserve(m);
+        std::vector<DepthInfo> info(num);
+        for (size_t i = 0; i < m; ++i) {
+            if (inner[i]) {
+                continue;
+            }
+            const auto &inst = exec_list[i];
+            if (chain_ops[i].empty()) {
+                res.push_back(inst);
+                track_depth(inst, info);
+                continue;
+            }
+            /// The operands of the chain by depth, which are combined two at a time into the inner indices, and at
+            /// last into the index of the chain.
+            std::multimap<DepthInfo, int> queue;
+            for (int op: chain_ops[i]) {
+                queue.emplace(info[op], op);
+            }
+            size_t next = 0;
+            while (queue.size() > 1) {
+                const int op1 = queue.begin()->second;
+                queue.erase(queue.begin());
+                const int op2 = queue.begin()->second;
+                queue.erase(queue.begin());
+                const int indx = queue.empty() ? res_indx_of(inst)
+                                               : res_indx_of(exec_list[chain_inners[i][next++]]);
+                const std::vector<int> op = inst[0] == 1 ? std::vector<int>{1, op1, op2, indx}
+                                                         : std::vector<int>{3, op1, op2, inst[3], indx};
+                res.push_back(op);
+                track_depth(op, info);
+                queue.emplace(info[indx], indx);
+            }
+        }
+        return res;
+    }
+
+    /**
+     * Returns the instructions that must wait for each instruction of the execution list. An instruction waits for
+     * the last instructions writing its operands or its result before it, and for the instructions reading its result
+     * before it, so running the instructions in any order that respects these gives the same values as running the
+     * execution list in order.
+     * @param exec_list the execution list.
+     * @param num the number of indices of the execution list.
+     * @return the instructions waiting for each instruction, without duplicates.
+     * */
+    inline std::vector<std::vector<size_t>> successors(const std::vector<std::vector<int>> &exec_list, size_t num) {
+        /// The instruction that last wrote each index, and the instructions that read it since.
+        std::vector<int> writer(num, -1);
+        std::vector<std::vector<size_t>> readers(num);
+        std::vector<std::vector<size_t>> succs(exec_list.size());
+        for (size_t i = 0; i < exec_list.size(); ++i) {
+            const auto &inst = exec_list[i];
+            const auto operands = operands_of(inst);
+            const int indx = res_indx_of(inst);
+            std::vector<size_t> preds;
+            for (int op: operands) {
+                if (writer[op] >= 0) {
+                    preds.push_back(writer[op]);
+                }
+            }
+            if (indx >= 0) {
+                if (writer[indx] >= 0) {
+                    preds.push_back(writer[indx]);
+                }
+                preds.insert(preds.end(), readers[indx].begin(), readers[indx].end());
+            }
+            std::sort(preds.begin(), preds.end());
+            preds.erase(std::unique(preds.begin(), preds.end()), preds.end());
+            for (size_t p: preds) {
+                succs[p].push_back(i);
+            }
+            for (int op: operands) {
+                readers[op].push_back(i);
+            }
+            if (indx >= 0) {
+                writer[indx] = int(i);
+                readers[indx].clear();
+            }
+        }
+        return succs;
+    }
+
+    /**
+     * Run the instructions of an execution list on num_threads threads, including the calling one. The threads are
+     * created once, and take the instructions from a queue of the ones whose predecessors, as given by successors,
+     * are done, so a slow multiplication only delays the instructions using its result. The constants are tracked by
+     * fold_consts right before each instruction runs, after the ones it reads are set. If some instruction throws,
+     * the first exception is rethrown once all threads have finished.
+     * @param exec_list the execution list.
+     * @param num the number of indices of the execution list.
+     * @param num_threads the number of threads running the instructions.
+     * @param consts the constants, as for fold_consts.
+     * @param plain_modulus the HE plaintext modulus.
+     * @param run called as run(i, folded, t) to execute the instruction i on the thread t < num_threads, where folded
+     *          tells whether the result of the instruction is a constant.
+     * */
+    template<typename F>
+    void run_scheduled(const std::vector<std::vector<int>> &exec_list, size_t num, size_t num_threads,
+                       std::vector<std::optional<int64_t>> &consts, uint64_t plain_modulus, F run) {
+        const size_t m = exec_list.size();
+        num_threads = std::max<size_t>(1, std::min(num_threads, m));
+        if (num_threads == 1) {
+            for (size_t i = 0; i < m; ++i) {
+                run(i, fold_consts(exec_list[i], consts, plain_modulus), 0);
+            }
+            return;
+        }
+
+        const auto succs = successors(exec_list, num);
+        /// The number of predecessors of each instruction that are not done yet.
+        std::vector<size_t> pending(m, 0);
+        for (const auto &s: succs) {
+            for (size_t i: s) {
+                pending[i]++;
+            }
+        }
+        std::deque<size_t> ready;
+        for (size_t i = 0; i < m; ++i) {
+            if (pending[i] == 0) {
+                ready.push_back(i);
+            }
+        }
+        size_t done = 0;
+        std::exception_ptr error;
+        std::mutex mutex;
+        std::condition_variable cv;
+        auto work = [&](size_t t) {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                cv.wait(lock, [&] { return !ready.empty() || done == m || error; });
+                if (done == m || error) {
+                    return;
+                }
+                const size_t i = ready.front();
+                ready.pop_front();
+                lock.unlock();
+                try {
+                    run(i, fold_consts(exec_list[i], consts, plain_modulus), t);
+                } catch (...) {
+                    lock.lock();
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                    cv.notify_all();
+                    return;
+                }
+                lock.lock();
+                done++;
+                for (size_t j: succs[i]) {
+                    if (--pending[j] == 0) {
+                        ready.push_back(j);
+                    }
+                }
+                cv.notify_all();
+            }
+        };
+
+        std::vector<std::thread> workers;
+        workers.reserve(num_threads - 1);
+        for (size_t t = 1; t < num_threads; t++) {
+            workers.emplace_back(work, t);
+        }
+        work(0);
+        for (auto &worker: workers) {
+            worker.join();
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    /**
+     * Plan the relinearizations and the levels of the ciphertexts for lazy relinearization. The result of an
+     * instruction is relinearized if a multiplication of two ciphertexts uses it, so a sum of products is
+     * relinearized once. It is switched down by its multiplicative depth, but kept at a level at least equal to the
+     * number of multiplications still to be done on it.
+     * @param exec_list a 2D vector representing the operations to be executed by the circuit.
+     * @param num the number of indices of the execution list.
+     * @param plain_modulus the HE plaintext modulus, for folding the constants.
+     * @param top the chain index of the first level of the HE ciphertexts.
+     * @param relin_res set to whether the result of each instruction is relinearized.
+     * @param res_levels set to the chain index the result of each instruction is switched down to.
+     * */
+    inline void plan_lazy_he(const std::vector<std::vector<int>> &exec_list, size_t num, uint64_t plain_modulus,
+                             size_t top, std::vector<char> &relin_res, std::vector<size_t> &res_levels) {
+        const size_t m = exec_list.size();
+        relin_res.assign(m, false);
+        res_levels.assign(m, 0);
+        std::vector<std::optional<int64_t>> consts(num);
+        /// The instruction that last wrote each index, or -1 if it is an input or a constant.
+        std::vector<int> writer(num, -1);
+        /// The multiplicative depth of the result of each instruction, and the instructions using it.
+        std::vector<size_t> depth(m, 0);
+        std::vector<std::vector<size_t>> readers(m);
+        std::vector<char> is_mul(m, false);
+        int out = -1;
+        for (size_t i = 0; i < m; ++i) {
+            const auto &inst = exec_list[i];
+            const int opcode = inst[0];
+            const int indx = res_indx_of(inst);
+            is_mul[i] = opcode == 1 && !consts[inst[1]] && !consts[inst[2]];
+            if (fold_consts(inst, consts, plain_modulus) || opcode == 2 || indx < 0) {
+                if (indx >= 0) {
+                    writer[indx] = -1;
+                }
+                continue;
+            }
+            for (int op: operands_of(inst)) {
+                if (writer[op] >= 0) {
+                    depth[i] = std::max(depth[i], depth[writer[op]]);
+                    readers[writer[op]].push_back(i);
+                    relin_res[writer[op]] = relin_res[writer[op]] || is_mul[i];
+                }
+            }
+            depth[i] += is_mul[i];
+            writer[indx] = int(i);
+            out = int(i);
+        }
+        // The result is relinearized, as it is sent back.
+        if (out >= 0) {
+            relin_res[out] = true;
+        }
+        /// The number of multiplications on the longest path from the result of each instruction to the result.
+        std::vector<size_t> remaining(m, 0);
+        for (size_t i = m; i-- > 0;) {
+            for (size_t j: readers[i]) {
+                remaining[i] = std::max(remaining[i], remaining[j] + is_mul[j]);
+            }
+        }
+        for (size_t i = 0; i < m; ++i) {
+            res_levels[i] = std::max(remaining[i], top - std::min(depth[i], top));
+        }
+    }
+}
+
+#endif //RINGSNARK_OPL_PASSES_H
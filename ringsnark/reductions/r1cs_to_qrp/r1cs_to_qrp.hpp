@@ -33,6 +33,13 @@
 
 namespace ringsnark {
 
+/**
+ * Degree of the QRP that cs reduces to, i.e., the size of its evaluation domain. This can exceed the number of
+ * constraints, since the domain may be padded up to a power of two.
+ */
+    template<typename RingT>
+    size_t r1cs_to_qrp_degree(const r1cs_constraint_system<RingT> &cs);
+
 /**
  * Instance map for the R1CS-to-QRP reduction.
  */
@@ -50,6 +57,9 @@ namespace ringsnark {
  * Witness map for the R1CS-to-QRP reduction.
  *
  * The witness map takes zero knowledge into account when d1,d2,d3 are random.
+ *
+ * If lagrange_basis is set, the A/B/C io and mid polynomials of the witness are given in the Lagrange basis of the
+ * evaluation domain, i.e., as their evaluations on the domain, which saves interpolating them.
  */
     template<typename RingT>
     qrp_witness <RingT> r1cs_to_qrp_witness_map(const r1cs_constraint_system<RingT> &cs,
@@ -57,7 +67,8 @@ namespace ringsnark {
                                                 const r1cs_auxiliary_input<RingT> &auxiliary_input,
                                                 const RingT &d1,
                                                 const RingT &d2,
-                                                const RingT &d3);
+                                                const RingT &d3,
+                                                bool lagrange_basis = false);
 
 } // ringsnark
 
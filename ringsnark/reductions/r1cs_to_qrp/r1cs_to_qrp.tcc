@@ -14,6 +14,11 @@
 
 namespace ringsnark {
 
+    template<typename RingT>
+    size_t r1cs_to_qrp_degree(const r1cs_constraint_system<RingT> &cs) {
+        return get_evaluation_domain<RingT>(cs.num_constraints())->m;
+    }
+
 /**
  * Instance map for the R1CS-to-QRP reduction.
  *
@@ -146,6 +151,8 @@ namespace ringsnark {
  *  (5) compute coefficients of H
  *  (6) patch H to account for d1,d2,d3 (i.e., add coefficients of the polynomial (A d2 + B d1 - d3) + d1*d2*Z )
  *
+ * If lagrange_basis is set, the io and mid parts of A,B,C are returned as their evaluations on S, skipping (2) for them.
+ *
  * The code below is not as simple as the above high-level description due to
  * some reshuffling to save space.
  */
@@ -155,7 +162,8 @@ namespace ringsnark {
                                                const r1cs_auxiliary_input<RingT> &auxiliary_input,
                                                const RingT &d1,
                                                const RingT &d2,
-                                               const RingT &d3) {
+                                               const RingT &d3,
+                                               const bool lagrange_basis) {
 #ifdef DEBUG
         /* sanity check */
         assert(cs.is_satisfied(primary_input, auxiliary_input));
@@ -170,39 +178,58 @@ namespace ringsnark {
         /* Compute coefficients for A_mid, B_mid, C_mid */
         r1cs_variable_assignment<RingT> auxiliary_assignment(primary_input.size(), RingT::zero());
         auxiliary_assignment.insert(auxiliary_assignment.end(), auxiliary_input.begin(), auxiliary_input.end());
-        std::vector<RingT> a_mid_, b_mid_, c_mid_;
-        a_mid_.reserve(cs.num_constraints());
-        b_mid_.reserve(cs.num_constraints());
-        c_mid_.reserve(cs.num_constraints());
+        std::vector<RingT> a_mid, b_mid, c_mid;
+        a_mid.reserve(domain->m);
+        b_mid.reserve(domain->m);
+        c_mid.reserve(domain->m);
+        // The constant term (index 0) belongs to the io part only, like A_0(t) in the instance map, whereas
+        // evaluate() would also add it here
+        const auto evaluate_mid = [&auxiliary_assignment](const linear_combination<RingT> &lc) {
+            RingT acc = RingT::zero();
+            for (const auto &lt: lc.terms) {
+                if (lt.index != 0) {
+                    acc += auxiliary_assignment[lt.index - 1] * lt.coeff;
+                }
+            }
+            return acc;
+        };
         for (size_t i = 0; i < cs.num_constraints(); ++i) {
-            a_mid_.push_back(cs.constraints[i].a.evaluate(auxiliary_assignment));
-            b_mid_.push_back(cs.constraints[i].b.evaluate(auxiliary_assignment));
-            c_mid_.push_back(cs.constraints[i].c.evaluate(auxiliary_assignment));
+            a_mid.push_back(evaluate_mid(cs.constraints[i].a));
+            b_mid.push_back(evaluate_mid(cs.constraints[i].b));
+            c_mid.push_back(evaluate_mid(cs.constraints[i].c));
+        }
+        // The domain may be larger than the number of constraints, the remaining points are all-zero constraints
+        a_mid.resize(domain->m, RingT::zero());
+        b_mid.resize(domain->m, RingT::zero());
+        c_mid.resize(domain->m, RingT::zero());
+
+        if (!lagrange_basis) {
+            domain->iFFT(a_mid);
+            domain->iFFT(b_mid);
+            domain->iFFT(c_mid);
         }
-
-        vector<RingT> xs(domain->m);
-        for (size_t i = 0; i < domain->m; i++) { xs[i] = domain->get_domain_element(i); }
-        auto a_mid = interpolate(xs, a_mid_);
-        auto b_mid = interpolate(xs, b_mid_);
-        auto c_mid = interpolate(xs, c_mid_);
 
         r1cs_variable_assignment<RingT> primary_assignment(primary_input);
         vector<RingT> zeros(auxiliary_input.size(), RingT::zero());
         primary_assignment.insert(primary_assignment.end(), zeros.begin(), zeros.end());
         std::vector<RingT> a_io, b_io, c_io;
-        a_io.reserve(cs.num_constraints());
-        b_io.reserve(cs.num_constraints());
-        c_io.reserve(cs.num_constraints());
+        a_io.reserve(domain->m);
+        b_io.reserve(domain->m);
+        c_io.reserve(domain->m);
         for (size_t i = 0; i < cs.num_constraints(); ++i) {
             a_io.push_back(cs.constraints[i].a.evaluate(primary_assignment));
             b_io.push_back(cs.constraints[i].b.evaluate(primary_assignment));
             c_io.push_back(cs.constraints[i].c.evaluate(primary_assignment));
         }
-
-        for (size_t i = 0; i < domain->m; i++) { xs[i] = domain->get_domain_element(i); }
-        a_io = interpolate(xs, a_io);
-        b_io = interpolate(xs, b_io);
-        c_io = interpolate(xs, c_io);
+        a_io.resize(domain->m, RingT::zero());
+        b_io.resize(domain->m, RingT::zero());
+        c_io.resize(domain->m, RingT::zero());
+
+        if (!lagrange_basis) {
+            domain->iFFT(a_io);
+            domain->iFFT(b_io);
+            domain->iFFT(c_io);
+        }
 
 
         // Compute coefficients for vanishing polynomial Z
@@ -215,9 +242,9 @@ namespace ringsnark {
             aB[i] += cs.constraints[i].b.evaluate(full_variable_assignment);
             aC[i] += cs.constraints[i].c.evaluate(full_variable_assignment);
         }
-        aA = interpolate(xs, aA);
-        aB = interpolate(xs, aB);
-        aC = interpolate(xs, aC);
+        domain->iFFT(aA);
+        domain->iFFT(aB);
+        domain->iFFT(aC);
 
         std::vector<RingT> coefficients_for_H(domain->m + 1, RingT::zero());
 #ifdef MULTICORE
@@ -232,12 +259,7 @@ namespace ringsnark {
         domain->add_poly_Z(d1 * d2, coefficients_for_H);
 
         // Compute coefficients of (A*B - C) / Z
-        auto min_C(aC);
-        for (auto &c_i: min_C) { c_i.negate_inplace(); }
-        auto prod = multiply(aA, aB);
-        auto diff = add(prod, min_C);
-        auto H_tmp(diff);
-        domain->divide_by_Z_on_coset(H_tmp);
+        const auto H_tmp = domain->compute_quotient(aA, aB, aC);
 
 #ifdef MULTICORE
 #pragma omp parallel for
@@ -10,34 +10,220 @@ See qrp.hpp .
 #ifndef QRP_TCC_
 #define QRP_TCC_
 
+#include <algorithm>
+#include <optional>
+#include <unordered_map>
+#include "ringsnark/util/parallel.hpp"
+#include "ringsnark/util/ring_utils.hpp"
+
 namespace ringsnark {
+    namespace {
+        /**
+         * Return coeff in the form in which it multiplies Ts: a T::Multiplier if T provides one, coeff itself otherwise.
+         */
+        template<typename T, typename U>
+        auto prepare_multiplier(const U &coeff) {
+            if constexpr (has_prepared_multiplier<T>::value) {
+                return typename T::Multiplier(coeff);
+            } else {
+                return coeff;
+            }
+        }
+    }
+
+    /**
+     * Compute the inner products sum_i a_i * b_i of several vectors a, given as iterator ranges in as, with the same
+     * coefficients b. The a_i are (typically encodings) in T and the b_i are scalars in U.
+     *
+     * Since multiplying a T by a scalar is expensive compared to adding two Ts, terms are grouped by coefficient
+     * and each distinct coefficient is multiplied once: zero coefficients are skipped, terms with coefficient one are
+     * added without multiplication, and terms sharing any other coefficient are added up before being multiplied.
+     * Each distinct coefficient is prepared only once for all vectors in as (see has_prepared_multiplier).
+     *
+     * With num_threads > 1, the groups are split into chunks that are scaled and summed by separate threads, and the
+     * per-thread accumulators are added up by a reduction tree.
+     */
+    template<typename T, typename U>
+    std::vector<T> inner_products(const std::vector<std::pair<typename std::vector<T>::const_iterator,
+                                                              typename std::vector<T>::const_iterator>> &as,
+                                  typename std::vector<U>::const_iterator b_start,
+                                  typename std::vector<U>::const_iterator b_end,
+                                  const size_t num_threads = 1) {
+        const size_t n = b_end - b_start;
+        assert(!as.empty());
+        assert(n > 0 && "cannot compute inner product of empty vectors");
+        assert(std::all_of(as.begin(), as.end(), [n](const auto &a) { return (size_t) (a.second - a.first) == n; })
+               && "cannot compute inner product of vectors with mismatched sizes");
+
+        // members[g] holds the indices i with b_i = coeffs[g], in order of first occurrence
+        std::unordered_map<U, size_t> group_idx;
+        std::vector<U> coeffs;
+        std::vector<std::vector<size_t>> members;
+        for (size_t i = 0; i < n; i++) {
+            const U &b_i = *(b_start + i);
+            if (b_i.is_zero()) {
+                continue;
+            }
+            auto [it, inserted] = group_idx.emplace(b_i, coeffs.size());
+            if (inserted) {
+                coeffs.push_back(b_i);
+                members.emplace_back();
+            }
+            members[it->second].push_back(i);
+        }
+
+        std::vector<T> res;
+        res.reserve(as.size());
+        if (coeffs.empty()) {
+            for (const auto &a: as) {
+                T zero(*a.first);
+                zero *= U::zero();
+                res.push_back(zero);
+            }
+            return res;
+        }
+
+        using multiplier_type = decltype(prepare_multiplier<T, U>(std::declval<const U &>()));
+        const U one = U::one();
+        const size_t num_chunks = std::min(num_threads, coeffs.size());
+        // chunk_sums[k][t] accumulates the terms of the k-th inner product in the t-th chunk of groups
+        std::vector<std::vector<std::optional<T>>> chunk_sums(as.size(), std::vector<std::optional<T>>(num_chunks));
+        parallel_for(num_chunks, num_chunks, [&](const size_t t) {
+            for (size_t g = t * coeffs.size() / num_chunks; g < (t + 1) * coeffs.size() / num_chunks; g++) {
+                std::optional<multiplier_type> multiplier;
+                if (!(coeffs[g] == one)) {
+                    multiplier.emplace(prepare_multiplier<T, U>(coeffs[g]));
+                }
+                for (size_t k = 0; k < as.size(); k++) {
+                    T sum(*(as[k].first + members[g][0]));
+                    for (size_t j = 1; j < members[g].size(); j++) {
+                        sum += *(as[k].first + members[g][j]);
+                    }
+                    if (multiplier) {
+                        sum *= *multiplier;
+                    }
+                    if (chunk_sums[k][t]) {
+                        *chunk_sums[k][t] += sum;
+                    } else {
+                        chunk_sums[k][t].emplace(std::move(sum));
+                    }
+                }
+            }
+        });
+
+        for (auto &sums: chunk_sums) {
+            std::vector<T> partials;
+            partials.reserve(num_chunks);
+            for (auto &chunk_sum: sums) {
+                partials.push_back(std::move(*chunk_sum));
+            }
+            res.push_back(parallel_sum(partials, num_threads));
+        }
+        return res;
+    }
+
+    /**
+     * Compute the inner products sum_i a_i * b_i, as in inner_products, for vectors a given in packed form (see
+     * T::encode_packed): the t-th element of each range in as holds a_{t*k}, ..., a_{t*k+k-1}, for the packing factor
+     * k of T. Each packed element is multiplied by its k coefficients at once, so only about n / k multiplications are
+     * needed. The results are folded with pk, so that they can be used as any other T.
+     *
+     * Packed elements whose coefficients are all zero are skipped, and those whose k coefficients are all one are
+     * added without multiplication.
+     */
+    template<typename T, typename U>
+    std::vector<T> packed_inner_products(const std::vector<std::pair<typename std::vector<T>::const_iterator,
+                                                                     typename std::vector<T>::const_iterator>> &as,
+                                         typename std::vector<U>::const_iterator b_start,
+                                         typename std::vector<U>::const_iterator b_end,
+                                         const typename T::PublicKey &pk,
+                                         const size_t num_threads = 1) {
+        const size_t n = b_end - b_start;
+        const size_t k = T::packing_factor();
+        const size_t num_packed = (n + k - 1) / k;
+        assert(!as.empty());
+        assert(n > 0 && "cannot compute inner product of empty vectors");
+        assert(std::all_of(as.begin(), as.end(),
+                           [num_packed](const auto &a) { return (size_t) (a.second - a.first) == num_packed; })
+               && "cannot compute inner product of vectors with mismatched sizes");
+
+        std::vector<size_t> nonzero;
+        for (size_t t = 0; t < num_packed; t++) {
+            if (std::any_of(b_start + t * k, b_start + std::min(n, (t + 1) * k), [](const U &b) { return !b.is_zero(); })) {
+                nonzero.push_back(t);
+            }
+        }
+
+        std::vector<T> res;
+        res.reserve(as.size());
+        if (nonzero.empty()) {
+            for (const auto &a: as) {
+                T zero(*a.first);
+                zero *= U::zero();
+                res.push_back(zero);
+            }
+            return res;
+        }
+
+        const U one = U::one();
+        const size_t num_chunks = std::min(num_threads, nonzero.size());
+        // chunk_sums[j][c] accumulates the terms of the j-th inner product in the c-th chunk of packed elements
+        std::vector<std::vector<std::optional<T>>> chunk_sums(as.size(), std::vector<std::optional<T>>(num_chunks));
+        parallel_for(num_chunks, num_chunks, [&](const size_t c) {
+            for (size_t idx = c * nonzero.size() / num_chunks; idx < (c + 1) * nonzero.size() / num_chunks; idx++) {
+                const size_t t = nonzero[idx];
+                const auto b_first = b_start + t * k, b_last = b_start + std::min(n, (t + 1) * k);
+                // A partial last chunk still needs a multiplication, to clear the blocks beyond a_{n-1}
+                std::optional<typename T::Multiplier> multiplier;
+                if ((size_t) (b_last - b_first) < k
+                    || !std::all_of(b_first, b_last, [&one](const U &b) { return b == one; })) {
+                    multiplier.emplace(std::vector<U>(b_first, b_last));
+                }
+                for (size_t j = 0; j < as.size(); j++) {
+                    T term(*(as[j].first + t));
+                    if (multiplier) {
+                        term *= *multiplier;
+                    }
+                    if (chunk_sums[j][c]) {
+                        *chunk_sums[j][c] += term;
+                    } else {
+                        chunk_sums[j][c].emplace(std::move(term));
+                    }
+                }
+            }
+        });
+
+        for (auto &sums: chunk_sums) {
+            std::vector<T> partials;
+            partials.reserve(num_chunks);
+            for (auto &chunk_sum: sums) {
+                partials.push_back(std::move(*chunk_sum));
+            }
+            res.push_back(parallel_sum(partials, num_threads));
+        }
+        parallel_for(res.size(), num_threads, [&res, &pk](const size_t j) { res[j].fold_inplace(pk); });
+        return res;
+    }
+
+    /**
+     * Compute sum_i a_i * b_i (see inner_products).
+     */
     template<typename T, typename U>
     T inner_product(typename std::vector<T>::const_iterator a_start,
                     typename std::vector<T>::const_iterator a_end,
                     typename std::vector<U>::const_iterator b_start,
-                    typename std::vector<U>::const_iterator b_end) {
-        assert(a_end - a_start > 0 && "cannot compute inner product of empty vectors");
-        assert(a_end - a_start == b_end - b_start && "cannot compute inner product of vectors with mismatched sizes");
-        auto a_it = a_start;
-        auto b_it = b_start;
-        T res(*a_start);
-        a_it++;
-        res *= *b_start;
-        b_it++;
-        while (a_it != a_end) {
-            res += (*a_it) * (*b_it);
-            a_it++;
-            b_it++;
-        }
-        return res;
+                    typename std::vector<U>::const_iterator b_end,
+                    const size_t num_threads = 1) {
+        return inner_products<T, U>({{a_start, a_end}}, b_start, b_end, num_threads)[0];
     }
 
     template<typename T>
     T inner_product(typename std::vector<T>::const_iterator a_start,
                     typename std::vector<T>::const_iterator a_end,
                     typename std::vector<T>::const_iterator b_start,
-                    typename std::vector<T>::const_iterator b_end) {
-        return inner_product<T, T>(a_start, a_end, b_start, b_end);
+                    typename std::vector<T>::const_iterator b_end,
+                    const size_t num_threads = 1) {
+        return inner_product<T, T>(a_start, a_end, b_start, b_end, num_threads);
     }
 
 
@@ -160,6 +160,15 @@ namespace ringsnark {
         void report_linear_constraint_statistics() const;
     };
 
+/**
+ * Binary serialization of a constraint system, with RingT::save and RingT::load for the coefficients.
+ */
+    template<typename RingT>
+    void save_r1cs_constraint_system(std::ostream &out, const r1cs_constraint_system<RingT> &cs);
+
+    template<typename RingT>
+    r1cs_constraint_system<RingT> load_r1cs_constraint_system(std::istream &in);
+
 
 } // ringsnark
 
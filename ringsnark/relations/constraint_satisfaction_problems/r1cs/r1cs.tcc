@@ -22,6 +22,7 @@
 #include <cassert>
 #include <set>
 #include "r1cs.hpp"
+#include "../../../util/serialization.hpp"
 
 namespace ringsnark {
 
@@ -243,6 +244,44 @@ namespace ringsnark {
         return in;
     }
 
+    template<typename RingT>
+    void save_r1cs_constraint_system(std::ostream &out, const r1cs_constraint_system<RingT> &cs) {
+        write_uint64(out, cs.primary_input_size);
+        write_uint64(out, cs.auxiliary_input_size);
+        write_uint64(out, cs.num_constraints());
+        for (const r1cs_constraint<RingT> &c: cs.constraints) {
+            for (const linear_combination<RingT> *lc: {&c.a, &c.b, &c.c}) {
+                write_uint64(out, lc->terms.size());
+                for (const linear_term<RingT> &lt: lc->terms) {
+                    write_uint64(out, lt.index);
+                    lt.coeff.save(out);
+                }
+            }
+        }
+    }
+
+    template<typename RingT>
+    r1cs_constraint_system<RingT> load_r1cs_constraint_system(std::istream &in) {
+        r1cs_constraint_system<RingT> cs;
+        cs.primary_input_size = read_uint64(in);
+        cs.auxiliary_input_size = read_uint64(in);
+        const size_t num_constraints = read_uint64(in);
+        cs.constraints.resize(num_constraints);
+        for (r1cs_constraint<RingT> &c: cs.constraints) {
+            for (linear_combination<RingT> *lc: {&c.a, &c.b, &c.c}) {
+                lc->terms.resize(read_uint64(in));
+                for (linear_term<RingT> &lt: lc->terms) {
+                    lt.index = read_uint64(in);
+                    if (lt.index > cs.num_variables()) {
+                        throw std::invalid_argument("variable index out of range");
+                    }
+                    lt.coeff = RingT::load(in);
+                }
+            }
+        }
+        return cs;
+    }
+
     template<typename RingT>
     void r1cs_constraint_system<RingT>::report_linear_constraint_statistics() const {
 #ifdef DEBUG
@@ -1,5 +1,12 @@
 #include "seal_ring.hpp"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <sstream>
 #include <string>
+#include "seal/util/uintarithsmallmod.h"
+#include "../util/parallel.hpp"
+#include "../util/serialization.hpp"
 
 namespace ringsnark::seal {
     RingElem::RingElem() : value((Scalar) 0) {}
@@ -8,6 +15,25 @@ namespace ringsnark::seal {
 
     RingElem::RingElem(const polytools::SealPoly &poly) : value(polytools::SealPoly(poly)) {}
 
+    RingElem RingElem::get_root_of_unity(size_t order) {
+        if (order == 0 || (order & (order - 1)) != 0) {
+            throw std::invalid_argument("order must be a power of two");
+        }
+        auto parms = get_context().first_context_data()->parms();
+        const size_t N = parms.poly_modulus_degree();
+
+        // A constant is represented by the same value in all NTT slots of its limb
+        vector<uint64_t> coeffs(N * parms.coeff_modulus().size());
+        for (size_t i = 0; i < parms.coeff_modulus().size(); i++) {
+            uint64_t root = 1;
+            if (order > 1 && !::seal::util::try_minimal_primitive_root(order, parms.coeff_modulus()[i], root)) {
+                throw std::invalid_argument("no primitive root of unity of the given order");
+            }
+            std::fill_n(coeffs.begin() + i * N, N, root);
+        }
+        return RingElem(polytools::SealPoly(get_context(), coeffs, &get_context().first_parms_id()));
+    }
+
     [[nodiscard]] size_t RingElem::size_in_bits() const {
         if (is_scalar()) {
             return 8 * sizeof(Scalar);
@@ -70,7 +96,8 @@ namespace ringsnark::seal {
 
     bool RingElem::is_invertible() const noexcept {
         if (is_scalar()) {
-            bool success = to_poly().get_poly().invert_inplace();
+            RingElem r_poly(*this);
+            bool success = r_poly.to_poly_inplace().get_poly().invert_inplace();
             return success;
         } else if (is_poly()) {
             bool success = get_poly().invert_inplace();
@@ -99,6 +126,72 @@ namespace ringsnark::seal {
         }
     }
 
+    std::vector<size_t> RingElem::batch_invert(std::vector<RingElem> &elems) {
+        const size_t k = elems.size();
+        std::vector<size_t> non_invertible;
+        if (k == 0) {
+            return non_invertible;
+        }
+        auto parms = get_context().first_context_data()->parms();
+        const size_t N = parms.poly_modulus_degree();
+        const auto &coeff_modulus = parms.coeff_modulus();
+        const size_t slots = N * coeff_modulus.size();
+
+        // Flat double-CRT data of every element, in the layout of polytools::SealPoly
+        vector<vector<uint64_t>> data(k);
+        for (size_t e = 0; e < k; e++) {
+            RingElem tmp(elems[e]);
+            tmp.to_poly_inplace();
+            data[e].reserve(slots);
+            for (size_t j = 0; j < coeff_modulus.size(); j++) {
+                auto limb = tmp.get_poly().get_limb(j);
+                data[e].insert(data[e].end(), limb.begin(), limb.end());
+            }
+        }
+
+        // prefix[e][s] is the product of the non-zero values data[0][s], ..., data[e-1][s]
+        vector<bool> invertible(k, true);
+        vector<vector<uint64_t>> prefix(k);
+        vector<uint64_t> acc(slots, 1);
+        for (size_t e = 0; e < k; e++) {
+            prefix[e] = acc;
+            for (size_t s = 0; s < slots; s++) {
+                if (data[e][s] == 0) {
+                    invertible[e] = false;
+                } else {
+                    acc[s] = ::seal::util::multiply_uint_mod(acc[s], data[e][s], coeff_modulus[s / N]);
+                }
+            }
+        }
+
+        // acc only accumulates units, so it is invertible in every slot
+        for (size_t s = 0; s < slots; s++) {
+            if (!::seal::util::try_invert_uint_mod(acc[s], coeff_modulus[s / N], acc[s])) {
+                throw std::invalid_argument("coefficient moduli must be prime");
+            }
+        }
+
+        for (size_t e = k; e-- > 0;) {
+            for (size_t s = 0; s < slots; s++) {
+                if (data[e][s] != 0) {
+                    const auto &q = coeff_modulus[s / N];
+                    const uint64_t inv = ::seal::util::multiply_uint_mod(acc[s], prefix[e][s], q);
+                    acc[s] = ::seal::util::multiply_uint_mod(acc[s], data[e][s], q);
+                    data[e][s] = inv;
+                }
+            }
+        }
+
+        for (size_t e = 0; e < k; e++) {
+            if (invertible[e]) {
+                elems[e] = RingElem(polytools::SealPoly(get_context(), data[e], &get_context().first_parms_id()));
+            } else {
+                non_invertible.push_back(e);
+            }
+        }
+        return non_invertible;
+    }
+
     RingElem &RingElem::operator+=(const RingElem &other) {
         if (is_poly()) {
             if (other.is_poly()) {
@@ -211,9 +304,11 @@ namespace ringsnark::seal {
         } else if (lhs.is_poly() && rhs.is_poly()) {
             return lhs.get_poly().is_equal(rhs.get_poly());
         } else if (lhs.is_scalar() && rhs.is_poly()) {             // TODO: cast down to scalar instead?
-            return lhs.to_poly().get_poly().is_equal(rhs.get_poly());
+            RingElem lhs_poly(lhs);
+            return lhs_poly.to_poly_inplace().get_poly().is_equal(rhs.get_poly());
         } else if (lhs.is_poly() && rhs.is_scalar()) {             // TODO: cast down to scalar instead?
-            return lhs.get_poly().is_equal(rhs.to_poly().get_poly());
+            RingElem rhs_poly(rhs);
+            return lhs.get_poly().is_equal(rhs_poly.to_poly_inplace().get_poly());
         } else {
             throw RingElem::invalid_ring_elem_types();
         }
@@ -238,10 +333,14 @@ namespace ringsnark::seal {
         if (is_scalar()) {
             return this->get_scalar();
         } else if (is_poly()) {
+            // get_poly() returns a copy, so take it once rather than per coefficient
+            Poly poly = get_poly();
+            // A plain XOR cancels out whenever a value repeats an even number of times, e.g. for every constant in
+            // NTT form, so mix each value into the running hash instead
             size_t hash = 0;
-            for (size_t i = 0; i < get_poly().get_coeff_count(); i++) {
-                for (const auto &v: get_poly().get_coefficient_rns(i)) {
-                    hash ^= v;
+            for (size_t j = 0; j < poly.get_coeff_modulus_count(); j++) {
+                for (const auto &v: poly.get_limb(j)) {
+                    hash ^= v + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
                 }
             }
             return hash;
@@ -260,6 +359,155 @@ namespace ringsnark::seal {
         }
     }
 
+    void RingElem::save(std::ostream &out) const {
+        if (is_scalar()) {
+            // A scalar has no limbs
+            write_uint64(out, 0);
+            write_uint64(out, get_scalar());
+        } else if (is_poly()) {
+            Poly poly = get_poly();
+            write_uint64(out, poly.get_coeff_modulus_count());
+            write_uint64(out, poly.get_coeff_count());
+            for (size_t j = 0; j < poly.get_coeff_modulus_count(); j++) {
+                const auto limb = poly.get_limb(j);
+                out.write(reinterpret_cast<const char *>(limb.data()),
+                          static_cast<std::streamsize>(limb.size() * sizeof(uint64_t)));
+            }
+        } else {
+            throw invalid_ring_elem_types();
+        }
+    }
+
+    RingElem RingElem::load(std::istream &in) {
+        const size_t num_limbs = read_uint64(in);
+        if (num_limbs == 0) {
+            return RingElem(read_uint64(in));
+        }
+        auto parms = get_context().first_context_data()->parms();
+        const size_t ring_degree = read_uint64(in);
+        if (num_limbs != parms.coeff_modulus().size() || ring_degree != parms.poly_modulus_degree()) {
+            throw std::invalid_argument("ring element does not match the ring context");
+        }
+        vector<uint64_t> coeffs(num_limbs * ring_degree);
+        if (!in.read(reinterpret_cast<char *>(coeffs.data()),
+                     static_cast<std::streamsize>(coeffs.size() * sizeof(uint64_t)))) {
+            throw std::invalid_argument("unexpected end of stream");
+        }
+        for (size_t i = 0; i < num_limbs; i++) {
+            const uint64_t q_i = parms.coeff_modulus()[i].value();
+            if (std::any_of(coeffs.begin() + i * ring_degree, coeffs.begin() + (i + 1) * ring_degree,
+                            [q_i](const uint64_t c) { return c >= q_i; })) {
+                throw std::invalid_argument("ring element does not match the ring context");
+            }
+        }
+        return RingElem(polytools::SealPoly(get_context(), coeffs, &get_context().first_parms_id()));
+    }
+
+    void RingElem::save_parameters(std::ostream &out) {
+        get_context().first_context_data()->parms().save(out);
+    }
+
+    vector<::seal::SEALContext> EncodingElem::make_contexts(const size_t poly_modulus_degree,
+                                                           const vector<::seal::Modulus> &coeff_modulus) {
+        auto ring_params = RingElem::get_context().first_context_data()->parms();
+        vector<::seal::SEALContext> enc_contexts;
+        enc_contexts.reserve(ring_params.coeff_modulus().size());
+
+        for (size_t i = 0; i < ring_params.coeff_modulus().size(); i++) {
+            ::seal::EncryptionParameters enc_params(::seal::scheme_type::bgv);
+            enc_params.set_poly_modulus_degree(poly_modulus_degree);
+            enc_params.set_plain_modulus(ring_params.coeff_modulus()[i].value());
+            enc_params.set_coeff_modulus(coeff_modulus);
+            ::seal::SEALContext context(enc_params);
+
+            if (context.first_context_data()->qualifiers().parameter_error !=
+                ::seal::EncryptionParameterQualifiers::error_type::success) {
+                std::cerr << context.first_context_data()->qualifiers().parameter_error_name() << std::endl;
+                std::cerr << context.first_context_data()->qualifiers().parameter_error_message() << std::endl;
+                throw std::invalid_argument("");
+            }
+
+            assert(context.first_context_data()->qualifiers().using_batching == true);
+
+//                assert(context.using_keyswitching() == false); //TODO: can we always force this to be false while having enough noise budget for (potentially) many additions?
+
+            enc_contexts.push_back(context);
+        }
+        return enc_contexts;
+    }
+
+    void EncodingElem::set_context(const size_t max_terms, const size_t plain_mult_depth, const bool packed) {
+        auto ring_params = RingElem::get_context().first_context_data()->parms();
+        const size_t ring_degree = ring_params.poly_modulus_degree();
+        const auto &plain_moduli = ring_params.coeff_modulus();
+        int plain_bit_count = 0;
+        for (const auto &q_i: plain_moduli) {
+            plain_bit_count = std::max(plain_bit_count, q_i.bit_count());
+        }
+
+        // Try the degrees D = N, 2N, 4N, ... in turn, and stop at the first one whose largest secure coeff_modulus
+        // leaves enough noise budget
+        for (size_t poly_modulus_degree = ring_degree;
+             ::seal::CoeffModulus::MaxBitCount(poly_modulus_degree) > 0; poly_modulus_degree *= 2) {
+            // Batching requires all plain moduli to be 1 mod 2D, which then also fails for all larger degrees
+            if (!std::all_of(plain_moduli.begin(), plain_moduli.end(), [poly_modulus_degree](const auto &q_i) {
+                return (q_i.value() - 1) % (2 * poly_modulus_degree) == 0;
+            })) {
+                break;
+            }
+
+            double noise_bit_count = plain_bit_count + 5
+                                     + (double) plain_mult_depth * (plain_bit_count + std::log2(poly_modulus_degree) / 2)
+                                     + std::log2((double) std::max<size_t>(max_terms, 1));
+            if (packed) {
+                // Folding adds up D / N blocks, plus the key switching noise of the rotations
+                noise_bit_count += std::log2((double) (poly_modulus_degree / ring_degree)) + 1;
+            }
+            const int data_bit_count = (int) std::ceil(noise_bit_count) + 1;
+
+            // Split the data level evenly into primes of at most 60 bits, none of the same size as a plain modulus,
+            // so that they are coprime to the plain moduli
+            const auto coprime_bit_count = [&plain_moduli](int bit_count) {
+                while (std::any_of(plain_moduli.begin(), plain_moduli.end(),
+                                   [bit_count](const auto &q_i) { return q_i.bit_count() == bit_count; })) {
+                    bit_count++;
+                }
+                return bit_count;
+            };
+            size_t num_primes = (data_bit_count + 59) / 60;
+            int prime_bit_count = coprime_bit_count((int) ((data_bit_count + num_primes - 1) / num_primes));
+            if (prime_bit_count > 60) {
+                num_primes++;
+                prime_bit_count = coprime_bit_count((int) ((data_bit_count + num_primes - 1) / num_primes));
+            }
+            vector<int> coeff_modulus_bit_counts(num_primes, prime_bit_count);
+            // With more than one prime, SEAL reserves the last one for key switching. Unless the encodings are folded,
+            // no key switching takes place, so the smallest prime that is 1 mod 2D suffices.
+            if (packed) {
+                coeff_modulus_bit_counts.push_back(prime_bit_count);
+            } else if (num_primes > 1) {
+                coeff_modulus_bit_counts.push_back(coprime_bit_count((int) std::log2(poly_modulus_degree) + 4));
+            }
+            int total_bit_count = 0;
+            for (const int bit_count: coeff_modulus_bit_counts) {
+                total_bit_count += bit_count;
+            }
+            if (total_bit_count > ::seal::CoeffModulus::MaxBitCount(poly_modulus_degree)) {
+                continue;
+            }
+
+            vector<::seal::Modulus> coeff_modulus;
+            try {
+                coeff_modulus = ::seal::CoeffModulus::Create(poly_modulus_degree, coeff_modulus_bit_counts);
+            } catch (const std::logic_error &) {
+                continue; // Not enough primes of this size that are 1 mod 2D
+            }
+            set_contexts(make_contexts(poly_modulus_degree, coeff_modulus));
+            return;
+        }
+        throw std::invalid_argument("no secure encoding parameters leave enough noise budget for max_terms terms");
+    }
+
     size_t EncodingElem::size_in_bits() const {
         size_t size = 0;
         for (size_t i = 0; i < ciphertexts.size(); i++) {
@@ -272,77 +520,283 @@ namespace ringsnark::seal {
         return size;
     }
 
-    std::vector<EncodingElem> EncodingElem::encode(const SecretKey &sk, const std::vector<RingElem> &rs) {
-        assert(get_contexts().size() == sk.size());
-        std::vector<EncodingElem> encs;
-        ::seal::Plaintext ptxt;
+    void EncodingElem::save(std::ostream &out) const {
+        write_uint64(out, ciphertexts.size());
+        if (seeded_ciphertexts) {
+            // Ciphertext::load expands the seeds again
+            for (const auto &c: *seeded_ciphertexts) {
+                out.write(c.data(), (std::streamsize) c.size());
+            }
+            return;
+        }
+        for (const auto &c: ciphertexts) {
+            c.save(out);
+        }
+    }
+
+    EncodingElem EncodingElem::load(std::istream &in) {
+        if (read_uint64(in) != get_contexts().size()) {
+            throw std::invalid_argument("encoding does not match the encoding contexts");
+        }
         std::vector<::seal::Ciphertext> ciphertexts(get_contexts().size());
+        for (size_t i = 0; i < ciphertexts.size(); i++) {
+            ciphertexts[i].load(get_contexts()[i], in);
+        }
+        return EncodingElem(std::move(ciphertexts));
+    }
 
-        // Reuse encryptors for all elements
-        vector<::seal::Encryptor *> encryptors;
-        encryptors.reserve(get_contexts().size());
-        for (size_t i = 0; i < get_contexts().size(); i++) {
-            encryptors.push_back(new ::seal::Encryptor(get_contexts()[i], sk[i]));
+    void EncodingElem::save_pk(std::ostream &out, const PublicKey &pk) {
+        write_uint64(out, pk.size());
+        for (const auto &keys: pk) {
+            keys.save(out);
         }
+    }
 
-        for (const auto &r: rs) {
-            ::polytools::SealPoly poly = (r.is_scalar()) ? r.to_poly().get_poly() : r.get_poly();
+    EncodingElem::PublicKey EncodingElem::load_pk(std::istream &in) {
+        const size_t size = read_uint64(in);
+        if (size != 0 && size != get_contexts().size()) {
+            throw std::invalid_argument("public key does not match the encoding contexts");
+        }
+        PublicKey pk(size);
+        for (size_t i = 0; i < size; i++) {
+            pk[i].load(get_contexts()[i], in);
+        }
+        return pk;
+    }
 
-            // TODO: handle case where number of moduli differs, e.g., after mod-switching on the ring
-            assert(poly.get_coeff_modulus_count() == ciphertexts.size());
-            for (size_t i = 0; i < get_contexts().size(); i++) {
+    void EncodingElem::save_sk(std::ostream &out, const SecretKey &sk) {
+        write_uint64(out, sk.size());
+        for (const auto &key: sk) {
+            key.save(out);
+        }
+    }
+
+    EncodingElem::SecretKey EncodingElem::load_sk(std::istream &in) {
+        if (read_uint64(in) != get_contexts().size()) {
+            throw std::invalid_argument("secret key does not match the encoding contexts");
+        }
+        SecretKey sk(get_contexts().size());
+        for (size_t i = 0; i < sk.size(); i++) {
+            sk[i].load(get_contexts()[i], in);
+        }
+        return sk;
+    }
+
+    void EncodingElem::save_parameters(std::ostream &out) {
+        write_uint64(out, get_contexts().size());
+        for (const auto &context: get_contexts()) {
+            context.key_context_data()->parms().save(out);
+        }
+    }
+
+    std::vector<EncodingElem> EncodingElem::encrypt_slots(
+            const SecretKey &sk, const size_t n,
+            const std::function<std::vector<std::vector<uint64_t>>(size_t)> &slots, size_t num_threads,
+            const bool keep_seeded) {
+        assert(get_contexts().size() == sk.size());
+        const size_t num_limbs = get_contexts().size(), num_tasks = n * num_limbs;
+        num_threads = std::max<size_t>(1, std::min(num_threads, num_tasks));
+        std::vector<std::vector<::seal::Ciphertext>> ciphertexts(n, std::vector<::seal::Ciphertext>(num_limbs));
+        std::vector<std::vector<std::string>> seeded(keep_seeded ? n : 0, std::vector<std::string>(num_limbs));
+
+        // Each Encryptor draws the randomness of every encryption from a fresh PRNG of its context's factory,
+        // so threads share neither encryptors nor PRNGs
+        parallel_for(num_threads, num_threads, [&](const size_t thread) {
+            std::vector<std::unique_ptr<::seal::Encryptor>> encryptors(num_limbs);
+            ::seal::Plaintext ptxt;
+            std::vector<std::vector<uint64_t>> limbs;
+            size_t current = n;
+            for (size_t task = thread * num_tasks / num_threads; task < (thread + 1) * num_tasks / num_threads; task++) {
+                const size_t t = task / num_limbs, i = task % num_limbs;
+                if (t != current) {
+                    limbs = slots(t);
+                    assert(limbs.size() == num_limbs);
+                    current = t;
+                }
+                if (!encryptors[i]) {
+                    encryptors[i] = std::make_unique<::seal::Encryptor>(get_contexts()[i], sk[i]);
+                }
                 // TODO: encode() silently writes only up to the vector size. Could this cause problems down the line?
-                encoders[i]->encode(poly.get_limb(i), ptxt);
-                encryptors[i]->encrypt_symmetric(ptxt, ciphertexts[i]);
+                encoders[i]->encode(limbs[i], ptxt);
+                if (keep_seeded) {
+                    // The seeded ciphertext only exists in serialized form, so load the full one from it
+                    std::stringstream stream;
+                    encryptors[i]->encrypt_symmetric(ptxt).save(stream);
+                    seeded[t][i] = stream.str();
+                    ciphertexts[t][i].load(get_contexts()[i], stream);
+                } else {
+                    encryptors[i]->encrypt_symmetric(ptxt, ciphertexts[t][i]);
+                }
             }
+        });
 
-            encs.emplace_back(ciphertexts);
+        std::vector<EncodingElem> encs;
+        encs.reserve(n);
+        for (size_t t = 0; t < n; t++) {
+            encs.emplace_back(std::move(ciphertexts[t]));
+            if (keep_seeded) {
+                encs.back().seeded_ciphertexts = std::make_shared<const std::vector<std::string>>(std::move(seeded[t]));
+            }
         }
         return encs;
     }
 
+    std::vector<EncodingElem> EncodingElem::encode(const SecretKey &sk, const std::vector<RingElem> &rs,
+                                                   const size_t num_threads, const bool keep_seeded) {
+        return encrypt_slots(sk, rs.size(), [&](const size_t t) {
+            RingElem r(rs[t]);
+            ::polytools::SealPoly &poly = r.to_poly_inplace().get_poly();
+            // TODO: handle case where number of moduli differs, e.g., after mod-switching on the ring
+            assert(poly.get_coeff_modulus_count() == get_contexts().size());
+            std::vector<std::vector<uint64_t>> limbs(get_contexts().size());
+            for (size_t i = 0; i < limbs.size(); i++) {
+                limbs[i] = poly.get_limb(i);
+            }
+            return limbs;
+        }, num_threads, keep_seeded);
+    }
+
     RingElem EncodingElem::decode(const SecretKey &sk, const EncodingElem &e) {
-        // TODO: optimize to reuse same decryptor object for many invocations
+        return Decoder(sk).decode(e);
+    }
+
+    EncodingElem::Decoder::Decoder(const SecretKey &sk, const bool check_noise_budget)
+            : check_noise_budget(check_noise_budget) {
+        assert(get_contexts().size() == sk.size());
+        decryptors.reserve(get_contexts().size());
+        for (size_t i = 0; i < get_contexts().size(); i++) {
+            decryptors.emplace_back(new ::seal::Decryptor(get_contexts()[i], sk[i]));
+        }
+    }
+
+    void EncodingElem::Decoder::check_num_limbs(const EncodingElem &e) const {
+        if (e.ciphertexts.size() != decryptors.size()) {
+            throw std::invalid_argument("encoding does not hold one ciphertext per limb");
+        }
+    }
+
+    void EncodingElem::Decoder::decode_limb(const EncodingElem &e, const size_t i, uint64_t *limb) const {
+        const size_t ring_degree = RingElem::get_context().first_context_data()->parms().poly_modulus_degree();
+        // Encodings may come from an untrusted prover, so check the size, parms_id and data of the ciphertext
+        // against its context before decrypting it
+        if (!::seal::is_valid_for(e.ciphertexts[i], get_contexts()[i])) {
+            throw std::invalid_argument("ciphertext is not valid for its encoding context");
+        }
+        if (e.ciphertexts[i].size() == 0) {
+            // TODO: can we handle this case more explicitly to prevent confusion, e.g., have a dedicated
+            //  flag/subclass for the "0" ciphertext?
+            // This should only really be an issue when the SNARK is used in non-ZK mode;
+            // with ZK, the noise terms prevent the ctxt from being zero w.h.p.
+            std::fill(limb, limb + ring_degree, 0);
+            return;
+        }
+        if (check_noise_budget && decryptors[i]->invariant_noise_budget(e.ciphertexts[i]) <= 0) {
+            // This indicates that either the parameters of the encoding scheme were set to be too small,
+            // or that the prover used more budget (i.e., performed more operations) than required.
+            throw std::invalid_argument("not enough noise budget remaining at decryption");
+        }
         ::seal::Plaintext ptxt;
+        vector<uint64_t> slots;
+        decryptors[i]->decrypt(e.ciphertexts[i], ptxt);
+        encoders[i]->decode(ptxt, slots);
+        std::copy(slots.begin(), slots.begin() + ring_degree, limb); // Get rid of 0-padding
+    }
+
+    RingElem EncodingElem::Decoder::decode(const EncodingElem &e) const {
+        return decode(std::vector<std::reference_wrapper<const EncodingElem>>{e})[0];
+    }
+
+    void EncodingElem::Decoder::decode(const EncodingElem &e, RingElem &r, const size_t num_threads) const {
+        auto parms = RingElem::get_context().first_context_data()->parms();
+        const size_t ring_degree = parms.poly_modulus_degree(), num_limbs = decryptors.size();
+        assert(num_limbs == parms.coeff_modulus().size());
+        check_num_limbs(e);
+
+        std::vector<uint64_t> coeffs(ring_degree * num_limbs);
+        parallel_for(num_limbs, num_threads, [&](const size_t i) {
+            decode_limb(e, i, coeffs.data() + i * ring_degree);
+        });
+        r = RingElem(polytools::SealPoly(RingElem::get_context(), coeffs, &parms.parms_id()));
+    }
+
+    std::vector<RingElem> EncodingElem::Decoder::decode(
+            const std::vector<std::reference_wrapper<const EncodingElem>> &es, const size_t num_threads) const {
         auto parms = RingElem::get_context().first_context_data()->parms();
-        std::vector<uint64_t> coeffs;
+        const size_t ring_degree = parms.poly_modulus_degree(), num_limbs = decryptors.size();
+        assert(num_limbs == parms.coeff_modulus().size());
+        for (const EncodingElem &e: es) {
+            check_num_limbs(e);
+        }
 
-        assert(e.ciphertexts.size() == get_contexts().size());
-        for (size_t i = 0; i < e.ciphertexts.size(); i++) {
-            ::seal::Decryptor decryptor(get_contexts()[i], sk[i]);
-            vector<uint64_t> curr_limb(parms.poly_modulus_degree());
+        std::vector<std::vector<uint64_t>> coeffs(es.size(), std::vector<uint64_t>(ring_degree * num_limbs));
+        parallel_for(es.size() * num_limbs, num_threads, [&](const size_t task) {
+            const size_t j = task / num_limbs, i = task % num_limbs;
+            decode_limb(es[j].get(), i, coeffs[j].data() + i * ring_degree);
+        });
 
-            try {
-                if (decryptor.invariant_noise_budget(e.ciphertexts[i]) <= 0) {
-                    // This indicates that either the parameters of the encoding scheme were set to be too small,
-                    // or that the prover used more budget (i.e., performed more operations) than required.
-                    throw std::invalid_argument("not enough noise budget remaining at decryption");
-                }
-                decryptor.decrypt(e.ciphertexts[i], ptxt);
-                encoders[i]->decode(ptxt, curr_limb);
-            } catch (std::invalid_argument &e) {
-                if (std::string(e.what()) == "encrypted is empty") {
-                    // TODO: can we handle this case more explicitly to prevent confusion, e.g., have a dedicated
-                    //  flag/subclass for the "0" ciphertext?
-                    // This should only really be an issue when the SNARK is used in non-ZK mode;
-                    // with ZK, the noise terms prevent the ctxt from being zero w.h.p.
-                    // Do nothing, curr_limb already holds all zeros.
-                } else {
-                    throw e;
-                }
-            }
+        std::vector<RingElem> rs;
+        rs.reserve(es.size());
+        for (const auto &c: coeffs) {
+            rs.emplace_back(polytools::SealPoly(RingElem::get_context(), c, &parms.parms_id()));
+        }
+        return rs;
+    }
 
-            curr_limb.resize(parms.poly_modulus_degree()); // Get rid of 0-padding
-            coeffs.insert(coeffs.end(), curr_limb.begin(), curr_limb.end());
+    size_t EncodingElem::packing_factor() {
+        const size_t ring_degree = RingElem::get_context().first_context_data()->parms().poly_modulus_degree();
+        return get_contexts()[0].first_context_data()->parms().poly_modulus_degree() / ring_degree;
+    }
+
+    std::vector<int> EncodingElem::fold_steps() {
+        // The slots form a 2 x (D/2) matrix, so the column rotation adds up the two rows, and the row rotations by
+        // N, 2N, ... add up the blocks within a row
+        const size_t ring_degree = RingElem::get_context().first_context_data()->parms().poly_modulus_degree();
+        const size_t row_size = get_contexts()[0].first_context_data()->parms().poly_modulus_degree() / 2;
+        std::vector<int> steps = {0};
+        for (size_t step = ring_degree; step < row_size; step *= 2) {
+            steps.push_back((int) step);
+        }
+        return steps;
+    }
+
+    std::vector<std::vector<uint64_t>> EncodingElem::pack_limbs(const std::vector<RingElem> &rs) {
+        if (rs.size() > packing_factor()) {
+            throw std::invalid_argument("cannot pack more than packing_factor() ring elements");
+        }
+        const size_t ring_degree = RingElem::get_context().first_context_data()->parms().poly_modulus_degree();
+        std::vector<std::vector<uint64_t>> slots(get_contexts().size());
+        for (size_t i = 0; i < get_contexts().size(); i++) {
+            slots[i].resize(get_contexts()[i].first_context_data()->parms().poly_modulus_degree(), 0);
+        }
+        for (size_t j = 0; j < rs.size(); j++) {
+            if (rs[j].is_zero()) {
+                continue;
+            }
+            RingElem r_poly(rs[j]);
+            r_poly.to_poly_inplace();
+            ::polytools::SealPoly poly = r_poly.get_poly();
+            assert(poly.get_coeff_modulus_count() == get_contexts().size());
+            for (size_t i = 0; i < get_contexts().size(); i++) {
+                const auto limb = poly.get_limb(i);
+                std::copy(limb.begin(), limb.end(), slots[i].begin() + j * ring_degree);
+            }
         }
-        assert(coeffs.size() == parms.poly_modulus_degree() * parms.coeff_modulus().size());
-        return RingElem(polytools::SealPoly(RingElem::get_context(), coeffs, &parms.parms_id()));
+        return slots;
+    }
+
+    std::vector<EncodingElem> EncodingElem::encode_packed(const SecretKey &sk, const std::vector<RingElem> &rs,
+                                                          const size_t num_threads, const bool keep_seeded) {
+        const size_t k = packing_factor();
+        return encrypt_slots(sk, (rs.size() + k - 1) / k, [&](const size_t t) {
+            return pack_limbs(std::vector<RingElem>(rs.begin() + t * k, rs.begin() + std::min((t + 1) * k, rs.size())));
+        }, num_threads, keep_seeded);
     }
 
     EncodingElem &EncodingElem::operator+=(const EncodingElem &other) {
         // TODO: handle case where number of ciphertexts differ (and are > 1), e.g., in mod-switching cases?
         assert(this->ciphertexts.size() == other.ciphertexts.size());
         assert(this->ciphertexts.size() == get_contexts().size());
+        seeded_ciphertexts.reset();
         for (size_t i = 0; i < this->ciphertexts.size(); i++) {
             const bool was_ntt = this->ciphertexts[i].is_ntt_form();
             try {
@@ -360,11 +814,44 @@ namespace ringsnark::seal {
         return *this;
     }
 
+    EncodingElem::Multiplier::Multiplier(const RingElem &r) {
+        if (r.is_zero()) {
+            is_zero = true;
+            return;
+        }
+        RingElem r_poly(r);
+        r_poly.to_poly_inplace();
+        assert(r_poly.get_poly().get_coeff_modulus_count() == get_contexts().size());
+
+        plaintexts.resize(get_contexts().size());
+        for (size_t i = 0; i < get_contexts().size(); i++) {
+            encoders[i]->encode(r_poly.get_poly().get_limb(i), plaintexts[i]);
+            evaluators[i]->transform_to_ntt_inplace(plaintexts[i], get_contexts()[i].first_parms_id());
+        }
+    }
+
+    EncodingElem::Multiplier::Multiplier(const std::vector<RingElem> &rs) {
+        if (std::all_of(rs.begin(), rs.end(), [](const RingElem &r) { return r.is_zero(); })) {
+            is_zero = true;
+            return;
+        }
+        const auto slots = pack_limbs(rs);
+
+        plaintexts.resize(get_contexts().size());
+        for (size_t i = 0; i < get_contexts().size(); i++) {
+            encoders[i]->encode(slots[i], plaintexts[i]);
+            evaluators[i]->transform_to_ntt_inplace(plaintexts[i], get_contexts()[i].first_parms_id());
+        }
+    }
+
     EncodingElem &EncodingElem::operator*=(const RingElem &r) {
-        ::seal::Plaintext ptxt;
+        return this->operator*=(Multiplier(r));
+    }
 
+    EncodingElem &EncodingElem::operator*=(const Multiplier &m) {
+        seeded_ciphertexts.reset();
         // Handle zero case explicitly, to prevent a "transparent ciphertext" logic_error from SEAL
-        if (r.is_zero()) {
+        if (m.is_zero) {
             ciphertexts.resize(get_contexts().size());
             for (size_t i = 0; i < get_contexts().size(); i++) {
                 auto context = get_contexts()[i];
@@ -375,18 +862,43 @@ namespace ringsnark::seal {
             return *this;
         }
 
-        if (r.is_scalar()) {
-            return this->operator*=(r.to_poly());
-        } else if (r.is_poly()) {
-            assert(r.get_poly().get_coeff_modulus_count() == this->ciphertexts.size());
-
-            for (size_t i = 0; i < this->ciphertexts.size(); i++) {
-                encoders[i]->encode(r.get_poly().get_limb(i), ptxt);
-                evaluators[i]->multiply_plain_inplace(this->ciphertexts[i], ptxt);
+        assert(m.plaintexts.size() == this->ciphertexts.size());
+        for (size_t i = 0; i < this->ciphertexts.size(); i++) {
+            if (this->ciphertexts[i].parms_id() != m.plaintexts[i].parms_id()) {
+                throw std::invalid_argument("multiplier was prepared for a different level than the encoding");
+            }
+            if (!this->ciphertexts[i].is_ntt_form()) {
+                evaluators[i]->transform_to_ntt_inplace(this->ciphertexts[i]);
             }
+            evaluators[i]->multiply_plain_inplace(this->ciphertexts[i], m.plaintexts[i]);
+        }
+        return *this;
+    }
+
+    EncodingElem &EncodingElem::fold_inplace(const PublicKey &pk) {
+        if (packing_factor() == 1) {
             return *this;
-        } else {
-            throw RingElem::invalid_ring_elem_types();
         }
+        seeded_ciphertexts.reset();
+        const std::vector<int> steps = fold_steps();
+        if (pk.size() != this->ciphertexts.size()) {
+            throw std::invalid_argument("folding packed encodings requires the Galois keys from keygen(true)");
+        }
+        ::seal::Ciphertext rotated;
+        for (size_t i = 0; i < this->ciphertexts.size(); i++) {
+            if (this->ciphertexts[i].is_transparent()) {
+                continue; // The zero encoding folds to itself
+            }
+            if (!this->ciphertexts[i].is_ntt_form()) {
+                evaluators[i]->transform_to_ntt_inplace(this->ciphertexts[i]);
+            }
+            evaluators[i]->rotate_columns(this->ciphertexts[i], pk[i], rotated);
+            evaluators[i]->add_inplace(this->ciphertexts[i], rotated);
+            for (size_t j = 1; j < steps.size(); j++) {
+                evaluators[i]->rotate_rows(this->ciphertexts[i], steps[j], pk[i], rotated);
+                evaluators[i]->add_inplace(this->ciphertexts[i], rotated);
+            }
+        }
+        return *this;
     }
-}
\ No newline at end of file
+}
@@ -6,6 +6,8 @@
 #include <vector>
 #include <variant>
 #include <memory>
+#include <string>
+#include <functional>
 #include "seal/seal.h"
 #include "seal/util/rlwe.h"
 #include "poly_arith.h"
@@ -112,6 +114,13 @@ namespace ringsnark::seal {
             return res;
         }
 
+        /**
+         * Return the constant ring element whose residue modulo each q_i is a primitive order-th root of unity.
+         * The coefficient moduli are NTT-friendly primes (q_i = 1 mod 2N), so such roots exist for every power of two
+         * order up to 2N. Throws std::invalid_argument if order is not a power of two or some q_i has no such root.
+         */
+        static RingElem get_root_of_unity(size_t order);
+
         /*
          * Functions
          */
@@ -141,6 +150,14 @@ namespace ringsnark::seal {
             return res;
         }
 
+        /**
+         * Invert all invertible elements of elems in place, using Montgomery's trick independently in every NTT slot:
+         * one modular inversion per slot and 3(k-1) slot-wise multiplications for k elements.
+         * Elements that are not invertible, i.e., have a zero slot, are left unchanged and do not affect the others.
+         * Returns the (ascending) indices of the non-invertible elements.
+         */
+        static std::vector<size_t> batch_invert(std::vector<RingElem> &elems);
+
         RingElem &operator+=(const RingElem &other);
 
         RingElem &operator-=(const RingElem &other);
@@ -162,6 +179,19 @@ namespace ringsnark::seal {
 
         [[nodiscard]] size_t hash() const;
 
+        /**
+         * Binary serialization, as a scalar or as the limbs of a polynomial in NTT form. load throws
+         * std::invalid_argument if the data does not match the ring context.
+         */
+        void save(std::ostream &out) const;
+
+        static RingElem load(std::istream &in);
+
+        /**
+         * Write the parameters of the ring context, e.g., for keying caches of objects that depend on them.
+         */
+        static void save_parameters(std::ostream &out);
+
         class invalid_ring_elem_types : std::invalid_argument {
         public:
             explicit invalid_ring_elem_types() : invalid_argument("invalid types") {}
@@ -215,46 +245,66 @@ namespace ringsnark::seal {
         inline static std::vector<::seal::Evaluator *> evaluators;
 
         std::vector<::seal::Ciphertext> ciphertexts;
+        // SEAL's seed-compressed serialization of the ciphertexts, if kept when encrypting them (see encode), which
+        // save writes instead of the ciphertexts. Shared between copies, and dropped by every operation that
+        // changes the ciphertexts
+        std::shared_ptr<const std::vector<std::string>> seeded_ciphertexts;
 
         EncodingElem() = delete;
 
+        // Rotation steps used by fold_inplace: a column rotation (step 0), then row rotations by N, 2N, 4N, ...
+        static std::vector<int> fold_steps();
+
+        // Create one encoding context per limb of the ring, with the ring's limb moduli as plain moduli
+        static vector<::seal::SEALContext> make_contexts(size_t poly_modulus_degree,
+                                                         const vector<::seal::Modulus> &coeff_modulus);
+
+        // Write block j of the batching slots of each encoding context with the corresponding limb of rs[j]
+        static std::vector<std::vector<uint64_t>> pack_limbs(const std::vector<RingElem> &rs);
+
     public:
-        using PublicKey = nullptr_t; // No keying material needed to evaluate affine combinations of ciphertexts
+        // No keying material is needed to evaluate affine combinations of ciphertexts. Folding packed encodings
+        // (see encode_packed) needs Galois keys, one set per encoding context; otherwise, the public key is empty.
+        using PublicKey = std::vector<::seal::GaloisKeys>;
         using SecretKey = vector<::seal::SecretKey>;
 
         /*
          * Constructor
          */
-        EncodingElem(const EncodingElem &other) : ciphertexts(other.ciphertexts) {
+        EncodingElem(const EncodingElem &other) : ciphertexts(other.ciphertexts),
+                                                  seeded_ciphertexts(other.seeded_ciphertexts) {
             assert(!other.ciphertexts.empty());
         }
 
         /*
          * Static
          */
-        static std::tuple<PublicKey, SecretKey> keygen() {
+        /**
+         * If packed is set, the public key holds the Galois keys needed by fold_inplace.
+         */
+        static std::tuple<PublicKey, SecretKey> keygen(const bool packed = false) {
             SecretKey sk;
+            PublicKey pk;
             sk.reserve(get_contexts().size());
             for (const auto &context: get_contexts()) {
                 ::seal::KeyGenerator keygen(context);
                 sk.push_back(keygen.secret_key());
+                if (packed && packing_factor() > 1) {
+                    pk.emplace_back();
+                    keygen.create_galois_keys(fold_steps(), pk.back());
+                }
             }
-            PublicKey pk = nullptr;
 
-            return {nullptr, sk};
+            return {pk, sk};
         }
 
         static void set_context() {
             // TODO: find (joint) primes Q_1, ..., Q_L for encoding schemes s.t.
             // Q_1 > q_l, and Q, resp. L are just barely big enough to allow for a linear homomorphism
+            // (see set_context(max_terms, ...), which does so given a bound on the number of operations)
             const ::seal::SEALContext &ring_context = RingElem::get_context();
             auto ring_params = ring_context.first_context_data()->parms();
-            vector<::seal::SEALContext> enc_contexts;
-            enc_contexts.reserve(ring_params.coeff_modulus().size());
 
-            // Automagically find suitable poly_modulus_degree and coeff_modulus
-            auto max_plain_modulus = ring_params.coeff_modulus()[ring_params.coeff_modulus().size() - 1].value();
-            //TODO: binary search to find optimal_poly_modulus_degree; this would require knowing how many additions need to be performed
             auto poly_modulus_degree = 4 * ring_params.poly_modulus_degree();
             auto coeff_modulus_max_bit_count = ::seal::CoeffModulus::MaxBitCount(poly_modulus_degree);
             vector<int> coeff_modulus_bit_counts;
@@ -266,29 +316,20 @@ namespace ringsnark::seal {
             coeff_modulus_bit_counts.push_back(coeff_modulus_max_bit_count);
             auto coeff_modulus = ::seal::CoeffModulus::Create(poly_modulus_degree, coeff_modulus_bit_counts);
 
-            for (size_t i = 0; i < ring_params.coeff_modulus().size(); i++) {
-                ::seal::EncryptionParameters enc_params(::seal::scheme_type::bgv);
-                enc_params.set_poly_modulus_degree(poly_modulus_degree);
-                enc_params.set_plain_modulus(ring_params.coeff_modulus()[i].value());
-                enc_params.set_coeff_modulus(coeff_modulus);
-                ::seal::SEALContext context(enc_params);
-
-                if (context.first_context_data()->qualifiers().parameter_error !=
-                    ::seal::EncryptionParameterQualifiers::error_type::success) {
-                    std::cerr << context.first_context_data()->qualifiers().parameter_error_name() << std::endl;
-                    std::cerr << context.first_context_data()->qualifiers().parameter_error_message() << std::endl;
-                    throw std::invalid_argument("");
-                }
-
-                assert(context.first_context_data()->qualifiers().using_batching == true);
-
-//                assert(context.using_keyswitching() == false); //TODO: can we always force this to be false while having enough noise budget for (potentially) many additions?
-
-                enc_contexts.push_back(context);
-            }
-            set_contexts(enc_contexts);
+            set_contexts(make_contexts(poly_modulus_degree, coeff_modulus));
         }
 
+        /**
+         * Set up the encoding contexts with the smallest poly_modulus_degree and coeff_modulus that are secure and
+         * still leave noise budget for decoding a sum of max_terms encodings, each multiplied by plain_mult_depth ring
+         * elements in turn. If packed is set, the parameters also allow for the key switching used by fold_inplace.
+         *
+         * Noise growth is estimated heuristically: a fresh encoding uses about log(q_i) + 5 bits of the coefficient
+         * modulus, each multiplication by a uniformly random ring element about log(q_i) + log(D) / 2 further bits,
+         * and a sum of max_terms encodings at most log(max_terms) further bits.
+         */
+        static void set_context(size_t max_terms, size_t plain_mult_depth = 1, bool packed = false);
+
         static void set_contexts(const vector<::seal::SEALContext> &contexts_) {
             if (contexts.empty()) {
                 contexts = vector<::seal::SEALContext>(contexts_);
@@ -312,20 +353,117 @@ namespace ringsnark::seal {
         }
 
 
-        // Encode all elements in rs using the same BatchEncoder and Encryptor objects for efficiency
-        static std::vector<EncodingElem> encode(const SecretKey &sk, const std::vector<RingElem> &rs);
+        // Encode all elements in rs, with their limbs spread across up to num_threads threads; each thread reuses
+        // the same Encryptor objects for efficiency.
+        // If keep_seeded is set, the encodings also keep SEAL's seed-compressed form of their ciphertexts, in which
+        // the uniformly random half of a fresh symmetric encryption is replaced by the seed of its PRNG. save then
+        // writes about half the bytes, at the cost of holding the compressed form in memory as well
+        static std::vector<EncodingElem> encode(const SecretKey &sk, const std::vector<RingElem> &rs,
+                                                size_t num_threads = 1, bool keep_seeded = false);
 
+        /**
+         * Decode e with fresh decryptors, checking its noise budget (see Decoder, which reuses its decryptors).
+         */
         static RingElem decode(const SecretKey &sk, const EncodingElem &e);
 
+        /**
+         * Decodes encodings with one Decryptor per encoding context, created once rather than on every decode.
+         * Decoding does not modify the Decoder, so one Decoder can be used by several threads at once.
+         */
+        class Decoder {
+            std::vector<std::unique_ptr<::seal::Decryptor>> decryptors;
+            bool check_noise_budget;
+
+            // Throw std::invalid_argument unless e holds one ciphertext per limb
+            void check_num_limbs(const EncodingElem &e) const;
+
+            // Decode the i-th ciphertext of e, i.e., the i-th limb of the ring element, into limb
+            void decode_limb(const EncodingElem &e, size_t i, uint64_t *limb) const;
+
+        public:
+            /**
+             * If check_noise_budget is set, decoding an encoding without noise budget left throws, which costs one
+             * more decryption per limb. Otherwise, such an encoding decodes to an arbitrary ring element.
+             *
+             * Decoding a malformed encoding, i.e., one with the wrong number of ciphertexts or with a ciphertext that
+             * is not valid for its encoding context, throws std::invalid_argument.
+             */
+            explicit Decoder(const SecretKey &sk, bool check_noise_budget = true);
+
+            [[nodiscard]] RingElem decode(const EncodingElem &e) const;
+
+            /**
+             * Decode e into r, with its limbs spread across up to num_threads threads, e.g., for re-using the same
+             * scratch element in a decode-check loop.
+             */
+            void decode(const EncodingElem &e, RingElem &r, size_t num_threads = 1) const;
+
+            /**
+             * Decode all encodings in es, with their limbs spread across up to num_threads threads.
+             */
+            [[nodiscard]] std::vector<RingElem> decode(const std::vector<std::reference_wrapper<const EncodingElem>> &es,
+                                                       size_t num_threads = 1) const;
+        };
+
+        /**
+         * The number of ring elements that fit in the slots of one encoding, i.e., the ratio of the encoding and ring
+         * degrees. A single ring element only occupies the first block of N slots.
+         */
+        static size_t packing_factor();
+
+        /**
+         * Encode rs in packed form: the j-th block of N slots of the t-th encoding holds rs[t * k + j], for the
+         * packing factor k. The last encoding is padded with zeros.
+         *
+         * Multiplying a packed encoding by a Multiplier built from k ring elements multiplies the blocks separately,
+         * so a packed inner product takes about n / k plaintext multiplications; fold_inplace then sums the blocks.
+         */
+        static std::vector<EncodingElem> encode_packed(const SecretKey &sk, const std::vector<RingElem> &rs,
+                                                       size_t num_threads = 1, bool keep_seeded = false);
+
         /*
          * Members
          */
         [[nodiscard]] size_t size_in_bits() const;
 
         [[nodiscard]] static size_t size_in_bits_pk(const PublicKey &pk) {
-            return 0;
+            size_t size = 0;
+            for (size_t i = 0; i < pk.size(); i++) {
+                auto key_params = get_contexts()[i].key_context_data()->parms();
+                for (const auto &keys: pk[i].data()) {
+                    for (const auto &key: keys) {
+                        for (const auto &q_i: key_params.coeff_modulus()) {
+                            size += key_params.poly_modulus_degree() * key.data().size() * q_i.bit_count();
+                        }
+                    }
+                }
+            }
+            return size;
         }
 
+        /**
+         * Binary serialization of encodings and keys, in SEAL's serialization format, one object per encoding
+         * context. SEAL compresses the objects if it was built with zstd or zlib, and save writes fresh encodings
+         * from encode(..., keep_seeded = true) in seed-compressed form. load throws if the data does not match the
+         * encoding contexts.
+         */
+        void save(std::ostream &out) const;
+
+        static EncodingElem load(std::istream &in);
+
+        static void save_pk(std::ostream &out, const PublicKey &pk);
+
+        static PublicKey load_pk(std::istream &in);
+
+        static void save_sk(std::ostream &out, const SecretKey &sk);
+
+        static SecretKey load_sk(std::istream &in);
+
+        /**
+         * Write the parameters of the encoding contexts, e.g., for keying caches of objects that depend on them.
+         */
+        static void save_parameters(std::ostream &out);
+
         [[nodiscard]] static size_t size_in_bits_sk(const SecretKey &sk) {
             size_t size = 0;
             for (size_t i = 0; i < sk.size(); i++) {
@@ -339,11 +477,48 @@ namespace ringsnark::seal {
 
         EncodingElem &operator+=(const EncodingElem &other);
 
+        /**
+         * A ring element prepared for multiplying encodings: for each encoding context, the batch-encoded limb of the
+         * element, transformed to NTT form once. Encodings are BGV ciphertexts, which SEAL keeps in NTT form, so each
+         * multiplication by a Multiplier is a single dyadic product per ciphertext polynomial. Preparing an element
+         * once pays off when it multiplies several encodings, e.g., both E(s^i) and E(alpha * s^i).
+         */
+        class Multiplier {
+            std::vector<::seal::Plaintext> plaintexts;
+            bool is_zero = false;
+
+            friend class EncodingElem;
+
+        public:
+            explicit Multiplier(const RingElem &r);
+
+            /**
+             * Prepare the ring elements rs, at most packing_factor() many, for multiplying packed encodings blockwise.
+             */
+            explicit Multiplier(const std::vector<RingElem> &rs);
+        };
+
         EncodingElem &operator*=(const RingElem &other);
 
+        EncodingElem &operator*=(const Multiplier &other);
+
+        /**
+         * Sum up the blocks of a packed encoding, using the Galois keys from keygen(true). Afterwards, every block,
+         * and in particular the first one, which is the one decoded, holds the sum.
+         */
+        EncodingElem &fold_inplace(const PublicKey &pk);
+
         explicit EncodingElem(std::vector<::seal::Ciphertext> ciphertexts) : ciphertexts(std::move(ciphertexts)) {}
 
         friend bool operator==(const EncodingElem &lhs, const EncodingElem &rhs);
+
+    protected:
+        // Encrypt the batching slots slots(t)[i] under the i-th encoding context, for all t in [0, n), as n encodings.
+        // The pairs (t, i) are split into contiguous ranges across up to num_threads threads, each with its own
+        // encryptors, so slots(t) is called about once per t and thread
+        static std::vector<EncodingElem> encrypt_slots(const SecretKey &sk, size_t n,
+                                                       const std::function<std::vector<std::vector<uint64_t>>(size_t)> &slots,
+                                                       size_t num_threads, bool keep_seeded);
     };
 
     inline EncodingElem operator+(const EncodingElem &lhs, const EncodingElem &rhs) {
@@ -1,7 +1,9 @@
 #include <gtest/gtest.h>
+#include <sstream>
 
 #include "../seal/seal_ring.hpp"
 #include "../util/test_utils.hpp"
+#include "../util/ring_utils.hpp"
 
 size_t NUM_RING_ELEMS = 2;
 
@@ -45,6 +47,210 @@ namespace {
             EXPECT_EQ(r, rs[i]);
         }
     }
+
+    TYPED_TEST(EncodingTest, TestDecoder) {
+        using RingT = typename TypeParam::first_type;
+        using EncT = typename TypeParam::second_type;
+
+        auto [pk, sk] = EncT::keygen();
+        const vector<RingT> rs{RingT::random_element(), RingT(7), RingT::random_element()};
+        vector<EncT> es = EncT::encode(sk, rs);
+        es[1] *= RingT::zero();
+        for (const bool check_noise_budget: {true, false}) {
+            const typename EncT::Decoder decoder(sk, check_noise_budget);
+            EXPECT_EQ(decoder.decode(es[0]), rs[0]);
+            const vector<RingT> decoded = decoder.decode({es[0], es[1], es[2]}, 2);
+            EXPECT_EQ(decoded, (vector<RingT>{rs[0], RingT::zero(), rs[2]}));
+        }
+    }
+
+    TYPED_TEST(EncodingTest, TestDecoderRejectsMalformedEncodings) {
+        using RingT = typename TypeParam::first_type;
+        using EncT = typename TypeParam::second_type;
+
+        auto [pk, sk] = EncT::keygen();
+        const EncT e = EncT::encode(sk, {RingT::random_element()})[0];
+        const auto &contexts = EncT::get_contexts();
+
+        // A limb too many, ciphertexts for other parameters, and ciphertexts without parameters
+        ::seal::SEALContext other_context = get_context();
+        vector<::seal::Ciphertext> extra_limb, other_parms, no_parms(contexts.size());
+        for (const auto &context: contexts) {
+            extra_limb.emplace_back(context, context.first_parms_id());
+            other_parms.emplace_back(other_context, other_context.first_parms_id());
+        }
+        extra_limb.push_back(extra_limb.back());
+
+        const typename EncT::Decoder decoder(sk);
+        for (const auto &ciphertexts: {extra_limb, other_parms, no_parms}) {
+            const EncT malformed(ciphertexts);
+            EXPECT_THROW((void) decoder.decode(malformed), std::invalid_argument);
+            EXPECT_THROW((void) decoder.decode({e, malformed}, 2), std::invalid_argument);
+            EXPECT_THROW(EncT::decode(sk, malformed), std::invalid_argument);
+        }
+    }
+
+    TYPED_TEST(EncodingTest, TestPreparedMultiplier) {
+        using RingT = typename TypeParam::first_type;
+        using EncT = typename TypeParam::second_type;
+
+        auto [pk, sk] = EncT::keygen();
+        const vector<RingT> rs{RingT::random_element(), RingT::random_element()};
+        vector<EncT> es = EncT::encode(sk, rs);
+        for (const RingT &m: {RingT::random_element(), RingT(3), RingT::zero()}) {
+            const typename EncT::Multiplier prepared(m);
+            for (size_t i = 0; i < rs.size(); i++) {
+                EncT e(es[i]);
+                e *= prepared;
+                EXPECT_EQ(EncT::decode(sk, e), rs[i] * m);
+            }
+        }
+    }
+
+    TYPED_TEST(EncodingTest, TestPackedInnerProduct) {
+        using RingT = typename TypeParam::first_type;
+        using EncT = typename TypeParam::second_type;
+
+        auto [pk, sk] = EncT::keygen(true);
+        const size_t k = EncT::packing_factor();
+        vector<RingT> rs;
+        for (size_t i = 0; i < k + 2; i++) {
+            rs.push_back(RingT::random_element());
+        }
+        const vector<EncT> es = EncT::encode_packed(sk, rs);
+        ASSERT_EQ(es.size(), 2);
+        EXPECT_EQ(EncT::decode(sk, es[0]), rs[0]);
+        EXPECT_EQ(EncT::decode(sk, es[1]), rs[k]);
+
+        // The last chunk of coefficients is partial, so rs[k+1] must not contribute
+        vector<RingT> bs(k + 1, RingT::one());
+        bs[1] = RingT::zero();
+        bs[k] = RingT::random_element();
+        RingT expected = RingT::zero();
+        for (size_t i = 0; i < bs.size(); i++) {
+            expected += rs[i] * bs[i];
+        }
+        EncT res(es[0]);
+        res *= typename EncT::Multiplier(vector<RingT>(bs.begin(), bs.begin() + k));
+        EncT last(es[1]);
+        last *= typename EncT::Multiplier(vector<RingT>(bs.begin() + k, bs.end()));
+        res += last;
+        res.fold_inplace(pk);
+        EXPECT_EQ(EncT::decode(sk, res), expected);
+
+        EXPECT_THROW(typename EncT::Multiplier{rs}, std::invalid_argument);
+        EncT unfoldable(es[0]);
+        EXPECT_THROW(unfoldable.fold_inplace(std::get<0>(EncT::keygen())), std::invalid_argument);
+    }
+
+    TYPED_TEST(EncodingTest, TestSerialization) {
+        using RingT = typename TypeParam::first_type;
+        using EncT = typename TypeParam::second_type;
+
+        auto [pk, sk] = EncT::keygen(true);
+        const vector<RingT> rs{RingT::random_element(), RingT(7)};
+        const vector<EncT> es = EncT::encode_packed(sk, rs);
+
+        std::stringstream stream;
+        for (const RingT &r: rs) {
+            r.save(stream);
+        }
+        es[0].save(stream);
+        EncT::save_pk(stream, pk);
+        EncT::save_sk(stream, sk);
+
+        for (const RingT &r: rs) {
+            EXPECT_EQ(RingT::load(stream), r);
+        }
+        const EncT e = EncT::load(stream);
+        const auto loaded_pk = EncT::load_pk(stream);
+        const auto loaded_sk = EncT::load_sk(stream);
+        EXPECT_EQ(EncT::decode(loaded_sk, e), rs[0]);
+        EncT folded(e);
+        folded.fold_inplace(loaded_pk);
+        EXPECT_EQ(EncT::decode(sk, folded), rs[0] + rs[1]);
+
+        std::stringstream full;
+        rs[0].save(full);
+        std::stringstream truncated(full.str().substr(0, full.str().size() - 1));
+        EXPECT_THROW(RingT::load(truncated), std::invalid_argument);
+    }
+
+    TYPED_TEST(EncodingTest, TestSeededSerialization) {
+        using RingT = typename TypeParam::first_type;
+        using EncT = typename TypeParam::second_type;
+
+        auto [pk, sk] = EncT::keygen();
+        const vector<RingT> rs{RingT::random_element(), RingT::random_element()};
+        const vector<EncT> seeded = EncT::encode(sk, rs, 1, true);
+        const EncT copy(seeded[0]);
+        std::stringstream seeded_stream, copy_stream, full_stream;
+        seeded[0].save(seeded_stream);
+        copy.save(copy_stream);
+        EncT::encode(sk, rs)[0].save(full_stream);
+
+        // The seed replaces the uniformly random half of each ciphertext
+        EXPECT_LT(seeded_stream.str().size(), full_stream.str().size() * 2 / 3);
+        EXPECT_EQ(copy_stream.str(), seeded_stream.str());
+        EXPECT_EQ(EncT::decode(sk, EncT::load(seeded_stream)), rs[0]);
+
+        // Operations on the encoding drop the seeds, which no longer match the ciphertexts
+        EncT sum(seeded[0]);
+        sum += seeded[1];
+        std::stringstream sum_stream;
+        sum.save(sum_stream);
+        EXPECT_EQ(EncT::decode(sk, EncT::load(sum_stream)), rs[0] + rs[1]);
+        EncT prod(seeded[0]);
+        prod *= rs[1];
+        std::stringstream prod_stream;
+        prod.save(prod_stream);
+        EXPECT_EQ(EncT::decode(sk, EncT::load(prod_stream)), rs[0] * rs[1]);
+    }
+
+    TEST(RingElemTest, TestBatchInversion) {
+        using ringsnark::seal::RingElem;
+        auto parms = RingElem::get_context().first_context_data()->parms();
+
+        // Invertible in all slots but one
+        vector<uint64_t> coeffs(parms.poly_modulus_degree() * parms.coeff_modulus().size(), 1);
+        coeffs[5] = 0;
+        RingElem zero_slot(polytools::SealPoly(RingElem::get_context(), coeffs, &RingElem::get_context().first_parms_id()));
+
+        vector<RingElem> rs{RingElem::random_invertible_element(), RingElem::zero(), RingElem(7),
+                            RingElem::random_invertible_element(), zero_slot};
+        vector<RingElem> inverses(rs);
+        EXPECT_EQ(RingElem::batch_invert(inverses), (vector<size_t>{1, 4}));
+        for (size_t i: {0, 2, 3}) {
+            EXPECT_EQ(rs[i] * inverses[i], RingElem::one());
+        }
+        EXPECT_EQ(inverses[1], rs[1]);
+        EXPECT_EQ(inverses[4], rs[4]);
+
+        EXPECT_THROW(ringsnark::batch_invert(rs), std::invalid_argument);
+        rs.erase(rs.begin() + 4);
+        rs.erase(rs.begin() + 1);
+        inverses = rs;
+        ringsnark::batch_invert(inverses);
+        for (size_t i = 0; i < rs.size(); i++) {
+            EXPECT_EQ(rs[i] * inverses[i], RingElem::one());
+        }
+    }
+
+    TEST(RingElemTest, TestEqualityComparesAllCoefficients) {
+        using ringsnark::seal::RingElem;
+        auto parms = RingElem::get_context().first_context_data()->parms();
+
+        // Differs from zero only in the very last coefficient
+        vector<uint64_t> coeffs(parms.poly_modulus_degree() * parms.coeff_modulus().size(), 0);
+        const RingElem zero_poly(polytools::SealPoly(RingElem::get_context(), coeffs, &RingElem::get_context().first_parms_id()));
+        coeffs.back() = 1;
+        const RingElem last(polytools::SealPoly(RingElem::get_context(), coeffs, &RingElem::get_context().first_parms_id()));
+
+        EXPECT_TRUE(zero_poly.is_zero());
+        EXPECT_FALSE(last.is_zero());
+        EXPECT_FALSE(last == zero_poly);
+        EXPECT_FALSE(last == RingElem::zero());
+    }
 }
 
 int main(int argc, char **argv) {
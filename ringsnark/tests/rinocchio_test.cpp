@@ -0,0 +1,234 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+#include "../seal/seal_ring.hpp"
+#include "../gadgetlib/protoboard.hpp"
+#include "../zk_proof_systems/rinocchio/rinocchio.hpp"
+#include "../zk_proof_systems/rinocchio/key_cache.hpp"
+
+size_t NUM_CONSTRAINTS = 3;
+size_t NUM_PROOFS = 4;
+
+::seal::SEALContext get_context() {
+    ::seal::EncryptionParameters params(::seal::scheme_type::bgv);
+    auto poly_modulus_degree = (size_t) pow(2, 11);
+    params.set_poly_modulus_degree(poly_modulus_degree);
+    params.set_coeff_modulus(::seal::CoeffModulus::BFVDefault(poly_modulus_degree));
+    params.set_plain_modulus(::seal::PlainModulus::Batching(poly_modulus_degree, 20));
+    ::seal::SEALContext context(params);
+    return context;
+}
+
+/**
+ * A protoboard for x^(NUM_CONSTRAINTS + 1), with x as the only primary input.
+ */
+template<typename RingT>
+ringsnark::protoboard<RingT> power_circuit(const RingT &x) {
+    ringsnark::protoboard<RingT> pb;
+    ringsnark::pb_variable_array<RingT> vars(NUM_CONSTRAINTS + 1, ringsnark::pb_variable<RingT>());
+    vars.allocate(pb, NUM_CONSTRAINTS + 1, "x");
+    pb.set_input_sizes(1);
+    for (size_t i = 0; i < NUM_CONSTRAINTS; i++) {
+        pb.add_r1cs_constraint(ringsnark::r1cs_constraint<RingT>(vars[i], vars[0], vars[i + 1]));
+    }
+
+    pb.val(vars[0]) = x;
+    for (size_t i = 0; i < NUM_CONSTRAINTS; i++) {
+        pb.val(vars[i + 1]) = pb.val(vars[i]) * x;
+    }
+    return pb;
+}
+
+/**
+ * A copy of vec with its k-th element replaced by t, for element types without assignment.
+ */
+template<typename T>
+vector<T> replace_at(const vector<T> &vec, const size_t k, const T &t) {
+    vector<T> res;
+    res.reserve(vec.size());
+    for (size_t i = 0; i < vec.size(); i++) {
+        res.push_back(i == k ? t : vec[i]);
+    }
+    return res;
+}
+
+namespace {
+    template<typename T>
+    class RinocchioTest : public testing::Test {
+    };
+
+    using Types = ::testing::Types<std::pair<ringsnark::seal::RingElem, ringsnark::seal::EncodingElem>>;
+    TYPED_TEST_SUITE(RinocchioTest, Types);
+
+    TYPED_TEST(RinocchioTest, TestBatchVerifier) {
+        using RingT = typename TypeParam::first_type;
+        using EncT = typename TypeParam::second_type;
+        using proof = ringsnark::rinocchio::proof<RingT, EncT>;
+
+        const auto cs = power_circuit(RingT::zero()).get_constraint_system();
+        const auto keypair = ringsnark::rinocchio::generator<RingT, EncT>(cs);
+        const auto pvk = ringsnark::rinocchio::verifier_process_vk(keypair.vk);
+
+        vector<ringsnark::r1cs_primary_input<RingT>> primary_inputs;
+        vector<proof> proofs;
+        for (size_t k = 0; k < NUM_PROOFS; k++) {
+            const auto pb = power_circuit(RingT::random_element());
+            ASSERT_TRUE(pb.is_satisfied());
+            primary_inputs.push_back(pb.primary_input());
+            proofs.push_back(ringsnark::rinocchio::prover(keypair.pk, pb.primary_input(), pb.auxiliary_input()));
+        }
+        EXPECT_TRUE(ringsnark::rinocchio::batch_verifier(pvk, primary_inputs, proofs));
+        EXPECT_TRUE(ringsnark::rinocchio::batch_verifier(keypair.vk, primary_inputs, proofs));
+        EXPECT_TRUE(ringsnark::rinocchio::find_invalid_proofs(pvk, primary_inputs, proofs).empty());
+
+        // Swap in the D of another proof, which only proof k then fails
+        const size_t k = 2;
+        const proof &p = proofs[k], &other = proofs[k + 1];
+        const auto tampered = replace_at(proofs, k, proof(p.A, p.A_prime, p.B, p.B_prime, p.C, p.C_prime,
+                                                          other.D, p.D_prime, p.F));
+        EXPECT_FALSE(ringsnark::rinocchio::batch_verifier(pvk, primary_inputs, tampered));
+        EXPECT_FALSE(ringsnark::rinocchio::batch_verifier(keypair.vk, primary_inputs, tampered));
+        EXPECT_EQ(ringsnark::rinocchio::find_invalid_proofs(pvk, primary_inputs, tampered), vector<size_t>{k});
+    }
+
+    TYPED_TEST(RinocchioTest, TestOnlineVerifier) {
+        using RingT = typename TypeParam::first_type;
+        using EncT = typename TypeParam::second_type;
+        using proof = ringsnark::rinocchio::proof<RingT, EncT>;
+
+        const auto cs = power_circuit(RingT::zero()).get_constraint_system();
+        const auto keypair = ringsnark::rinocchio::generator<RingT, EncT>(cs);
+        const auto pvk = ringsnark::rinocchio::verifier_process_vk(keypair.vk);
+
+        const auto pb = power_circuit(RingT::random_element()), other_pb = power_circuit(RingT::random_element());
+        const auto primary_input = pb.primary_input();
+        const proof p = ringsnark::rinocchio::prover(keypair.pk, primary_input, pb.auxiliary_input());
+        const proof other = ringsnark::rinocchio::prover(keypair.pk, other_pb.primary_input(),
+                                                         other_pb.auxiliary_input());
+
+        // Each proof fails exactly one check, taking the element it checks from the proof of another statement
+        const vector<std::pair<std::string, proof>> tampered = {
+                {"V knowledge", proof(p.A, other.A_prime, p.B, p.B_prime, p.C, p.C_prime, p.D, p.D_prime, p.F)},
+                {"W knowledge", proof(p.A, p.A_prime, p.B, other.B_prime, p.C, p.C_prime, p.D, p.D_prime, p.F)},
+                {"Y knowledge", proof(p.A, p.A_prime, p.B, p.B_prime, p.C, other.C_prime, p.D, p.D_prime, p.F)},
+                {"H knowledge", proof(p.A, p.A_prime, p.B, p.B_prime, p.C, p.C_prime, p.D, other.D_prime, p.F)},
+                {"beta", proof(p.A, p.A_prime, p.B, p.B_prime, p.C, p.C_prime, p.D, p.D_prime, other.F)},
+                {"divisibility", proof(p.A, p.A_prime, p.B, p.B_prime, p.C, p.C_prime, other.D, other.D_prime, p.F)},
+        };
+
+        EXPECT_TRUE(ringsnark::rinocchio::online_verifier(pvk, primary_input, p));
+        EXPECT_TRUE(ringsnark::rinocchio::verifier(keypair.vk, primary_input, p));
+        EXPECT_TRUE(ringsnark::rinocchio::batch_verifier(pvk, {primary_input}, {p}));
+        for (const auto &[check, t]: tampered) {
+            SCOPED_TRACE(check);
+            const bool res = ringsnark::rinocchio::online_verifier(pvk, primary_input, t);
+            EXPECT_FALSE(res);
+            // The regular and the batch verifier implement the same checks, and must agree
+            EXPECT_EQ(res, ringsnark::rinocchio::verifier(keypair.vk, primary_input, t));
+            EXPECT_EQ(res, ringsnark::rinocchio::batch_verifier(pvk, {primary_input}, {t}));
+        }
+    }
+
+    TYPED_TEST(RinocchioTest, TestLegacyLayout) {
+        using RingT = typename TypeParam::first_type;
+        using EncT = typename TypeParam::second_type;
+
+        const auto pb = power_circuit(RingT::random_element());
+        const auto cs = pb.get_constraint_system();
+        size_t sizes[2];
+        for (const bool legacy_layout: {false, true}) {
+            SCOPED_TRACE(legacy_layout);
+            const auto keypair = ringsnark::rinocchio::generator<RingT, EncT>(cs, false, false, legacy_layout);
+            const auto &pk = dynamic_cast<const ringsnark::rinocchio::proving_key<RingT, EncT> &>(keypair.pk);
+            EXPECT_EQ(pk.has_legacy_layout(), legacy_layout);
+            sizes[legacy_layout] = pk.size_in_bits();
+
+            const auto proof = ringsnark::rinocchio::prover(keypair.pk, pb.primary_input(), pb.auxiliary_input());
+            EXPECT_TRUE(ringsnark::rinocchio::verifier(keypair.vk, pb.primary_input(), proof));
+        }
+        // The legacy layout adds the unused encodings of alpha * r_* * Z(s) and r_* * *_i(s)
+        EXPECT_LT(sizes[false], sizes[true]);
+    }
+
+    TYPED_TEST(RinocchioTest, TestSaveLoadVerificationKey) {
+        using RingT = typename TypeParam::first_type;
+        using EncT = typename TypeParam::second_type;
+
+        const auto pb = power_circuit(RingT::random_element());
+        const auto keypair = ringsnark::rinocchio::generator<RingT, EncT>(pb.get_constraint_system());
+        const auto &vk = dynamic_cast<const ringsnark::rinocchio::verification_key<RingT, EncT> &>(keypair.vk);
+
+        std::stringstream ss;
+        ringsnark::rinocchio::save_verification_key(ss, vk);
+        const auto loaded = ringsnark::rinocchio::load_verification_key<RingT, EncT>(ss);
+        EXPECT_TRUE(loaded.pk.constraint_system == pb.get_constraint_system());
+
+        // Proofs made with either key verify under both
+        const auto proof = ringsnark::rinocchio::prover(loaded.pk, pb.primary_input(), pb.auxiliary_input());
+        EXPECT_TRUE(ringsnark::rinocchio::verifier(loaded, pb.primary_input(), proof));
+        EXPECT_TRUE(ringsnark::rinocchio::verifier(vk, pb.primary_input(), proof));
+        const auto original_proof = ringsnark::rinocchio::prover(keypair.pk, pb.primary_input(), pb.auxiliary_input());
+        EXPECT_TRUE(ringsnark::rinocchio::verifier(loaded, pb.primary_input(), original_proof));
+    }
+
+    TYPED_TEST(RinocchioTest, TestCachedGenerator) {
+        using RingT = typename TypeParam::first_type;
+        using EncT = typename TypeParam::second_type;
+        namespace fs = std::filesystem;
+
+        const fs::path cache_dir = fs::temp_directory_path() /
+                                   ("rinocchio_test-" + std::to_string(std::random_device()()));
+        const auto pb = power_circuit(RingT::random_element());
+        const auto cs = pb.get_constraint_system();
+
+        const auto keypair = ringsnark::rinocchio::cached_generator<RingT, EncT>(cache_dir.string(), cs);
+        EXPECT_EQ(fs::status(cache_dir).permissions(), fs::perms::owner_all);
+        vector<fs::path> files;
+        for (const auto &entry: fs::directory_iterator(cache_dir)) {
+            EXPECT_EQ(entry.status().permissions(), fs::perms::owner_read | fs::perms::owner_write);
+            files.push_back(entry.path());
+        }
+        ASSERT_EQ(files.size(), 1);
+
+        // The second run loads the same keys instead of generating new ones
+        const auto cached = ringsnark::rinocchio::cached_generator<RingT, EncT>(cache_dir.string(), cs);
+        const auto proof = ringsnark::rinocchio::prover(cached.pk, pb.primary_input(), pb.auxiliary_input());
+        EXPECT_TRUE(ringsnark::rinocchio::verifier(keypair.vk, pb.primary_input(), proof));
+
+        // The file holds the encodings in seed-compressed form, unlike the keys loaded from it
+        std::stringstream full;
+        ringsnark::rinocchio::save_verification_key(
+                full, dynamic_cast<const ringsnark::rinocchio::verification_key<RingT, EncT> &>(cached.vk));
+        EXPECT_LT(fs::file_size(files[0]), full.str().size() * 2 / 3);
+
+        // A cache directory that others can access is not used, and neither is one that is not a directory,
+        // but the keys are generated all the same
+        fs::remove_all(cache_dir);
+        fs::create_directory(cache_dir);
+        fs::permissions(cache_dir, fs::perms::owner_all | fs::perms::group_read | fs::perms::group_exec);
+        const auto uncached = ringsnark::rinocchio::cached_generator<RingT, EncT>(cache_dir.string(), cs);
+        EXPECT_TRUE(fs::is_empty(cache_dir));
+        fs::remove_all(cache_dir);
+        std::ofstream(cache_dir).put('x');
+        for (const auto &kp: {uncached, ringsnark::rinocchio::cached_generator<RingT, EncT>(cache_dir.string(), cs)}) {
+            const auto p = ringsnark::rinocchio::prover(kp.pk, pb.primary_input(), pb.auxiliary_input());
+            EXPECT_TRUE(ringsnark::rinocchio::verifier(kp.vk, pb.primary_input(), p));
+        }
+
+        fs::remove_all(cache_dir);
+    }
+}
+
+int main(int argc, char **argv) {
+    ::seal::SEALContext context = get_context();
+    ringsnark::seal::RingElem::set_context(context);
+    // The encoding contexts can only be set once, so all tests use the same circuit
+    ringsnark::rinocchio::set_encoding_context<ringsnark::seal::RingElem, ringsnark::seal::EncodingElem>(
+            power_circuit(ringsnark::seal::RingElem::zero()).get_constraint_system());
+
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -45,6 +45,28 @@ namespace {
             EXPECT_EQ(q[i], quotient[i]);
         }
     }
+
+    TYPED_TEST(DivisionTest, TestMultiplication) {
+        // Covers the schoolbook, Karatsuba and (for RingElem) FFT-based paths, with balanced and unbalanced factors
+        for (auto [n_x, n_y]: std::initializer_list<std::pair<size_t, size_t>>{{5, 7}, {20, 20}, {70, 25}, {40, 45}}) {
+            vector<TypeParam> x(n_x), y(n_y);
+            for (size_t i = 0; i < n_x; i++) { x[i] = TypeParam(i % 7 + 1); }
+            for (size_t i = 0; i < n_y; i++) { y[i] = TypeParam(i % 5 + 2); }
+
+            vector<TypeParam> expected(n_x + n_y - 1, TypeParam::zero());
+            for (size_t i = 0; i < n_x; i++) {
+                for (size_t j = 0; j < n_y; j++) {
+                    expected[i + j] += x[i] * y[j];
+                }
+            }
+
+            vector<TypeParam> res = multiply(x, y);
+            ASSERT_EQ(res.size(), expected.size());
+            for (size_t i = 0; i < expected.size(); i++) {
+                EXPECT_EQ(res[i], expected[i]);
+            }
+        }
+    }
 }
 
 int main(int argc, char **argv) {
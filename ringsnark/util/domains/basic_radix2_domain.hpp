@@ -0,0 +1,78 @@
+/** @file
+ *****************************************************************************
+ Declaration of interfaces for the "basic radix-2" evaluation domain.
+ Roughly, the domain has size m = 2^k and consists of the powers of a
+ primitive m-th root of unity omega, i.e., S = {1, omega, ..., omega^{m-1}}.
+ Over R_q, omega is the constant whose residue modulo each coefficient
+ modulus q_i is a primitive m-th root of unity in Z_{q_i}, so that all
+ differences of distinct elements of S are units.
+ *****************************************************************************
+ * @author     This file is part of libfqfft, developed by SCIPR Lab
+ *             and contributors (see AUTHORS).
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#ifndef BASIC_RADIX2_DOMAIN_HPP_
+#define BASIC_RADIX2_DOMAIN_HPP_
+
+#include "../evaluation_domain.hpp"
+#include "basic_radix2_domain_aux.hpp"
+
+namespace ringsnark {
+
+/**
+ * An evaluation domain that is a multiplicative subgroup of order m = 2^k.
+ *
+ * Requires RingT to provide a static RingT::get_root_of_unity(size_t order).
+ */
+    template<typename RingT>
+    class basic_radix2_domain : public evaluation_domain<RingT> {
+    protected:
+        RingT omega;
+        RingT m_inv;
+        RingT coset_generator;
+        RingT Z_inv_on_coset;
+        vector<RingT> Z_coeffs;
+
+    public:
+        /**
+         * Construct the domain of size m. Throws std::invalid_argument if m is not a power of two,
+         * RingT has no primitive m-th root of unity, or none of the m + 1 small integers tried as coset generator
+         * makes Z invertible on the coset.
+         */
+        explicit basic_radix2_domain(size_t m);
+
+        void FFT(std::vector<RingT> &a) override;
+
+        void iFFT(std::vector<RingT> &a) override;
+
+        /**
+         * Evaluate Z(t) = t^m - 1.
+         */
+        RingT compute_vanishing_polynomial(const RingT &t) const override;
+
+        /**
+         * Get the coefficients of Z(z) = z^m - 1.
+         */
+        const std::vector<RingT> &vanishing_polynomial() const override;
+
+        /**
+         * Replace P by the quotient P / (z^m - 1), in O(deg(P)) ring additions.
+         */
+        void divide_by_Z_on_coset(std::vector<RingT> &P) const override;
+
+        /**
+         * Compute the coefficients of (A*B - C) / Z by evaluating A, B and C on the coset g*S, on which Z is
+         * the constant g^m - 1, and interpolating the quotient back.
+         * Requires A, B and C to have at most m coefficients.
+         */
+        std::vector<RingT> compute_quotient(const std::vector<RingT> &A,
+                                            const std::vector<RingT> &B,
+                                            const std::vector<RingT> &C) override;
+    };
+
+} // ringsnark
+
+#include "basic_radix2_domain.tcc"
+
+#endif // BASIC_RADIX2_DOMAIN_HPP_
@@ -0,0 +1,150 @@
+/** @file
+ *****************************************************************************
+ Implementation of interfaces for the "basic radix-2" evaluation domain.
+
+ See basic_radix2_domain.hpp .
+ *****************************************************************************
+ * @author     This file is part of libfqfft, developed by SCIPR Lab
+ *             and contributors (see AUTHORS).
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#ifndef BASIC_RADIX2_DOMAIN_TCC_
+#define BASIC_RADIX2_DOMAIN_TCC_
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace ringsnark {
+    namespace {
+        template<typename RingT>
+        vector<RingT> radix2_domain_elements(const size_t m) {
+            if (m == 0 || (m & (m - 1)) != 0) {
+                throw std::invalid_argument("basic_radix2_domain: expected m to be a power of two");
+            }
+            const RingT omega = RingT::get_root_of_unity(m);
+            vector<RingT> values(m);
+            values[0] = RingT::one();
+            for (size_t i = 1; i < m; i++) {
+                values[i] = values[i - 1] * omega;
+            }
+            return values;
+        }
+
+        template<typename RingT>
+        RingT power(const RingT &base, size_t exp) {
+            RingT res = RingT::one();
+            RingT square = base;
+            while (exp > 0) {
+                if (exp & 1) {
+                    res *= square;
+                }
+                exp >>= 1;
+                if (exp > 0) {
+                    square *= square;
+                }
+            }
+            return res;
+        }
+    }
+
+    template<typename RingT>
+    basic_radix2_domain<RingT>::basic_radix2_domain(const size_t m)
+            : evaluation_domain<RingT>(radix2_domain_elements<RingT>(m)) {
+        omega = (m > 1) ? this->values[1] : RingT::one();
+        m_inv = RingT::one() / RingT(m);
+
+        Z_coeffs.resize(m + 1, RingT::zero());
+        Z_coeffs[0] = -RingT::one();
+        Z_coeffs[m] = RingT::one();
+
+        // The barycentric weights of S are w_i = omega^i / m
+        this->weights.reserve(m);
+        for (const auto &omega_i: this->values) {
+            this->weights.push_back(omega_i * m_inv);
+        }
+
+        // Z(g*omega^i) = g^m - 1 for all i, so any g for which this is a unit works as coset generator.
+        // Modulo a prime, k^m = 1 has at most m solutions, so m + 1 candidates suffice over a field.
+        for (uint64_t k = 2; k < m + 3; k++) {
+            const RingT Z_g = compute_vanishing_polynomial(RingT(k));
+            if (Z_g.is_invertible()) {
+                coset_generator = RingT(k);
+                Z_inv_on_coset = Z_g.inverse();
+                return;
+            }
+        }
+        throw std::invalid_argument("basic_radix2_domain: found no coset generator");
+    }
+
+    template<typename RingT>
+    void basic_radix2_domain<RingT>::FFT(vector<RingT> &a) {
+        if (a.size() != this->m) {
+            throw std::invalid_argument("expected a vector of size m");
+        }
+        // values[i] = omega^i, so they double as twiddle factors
+        _basic_radix2_FFT(a, this->values);
+    }
+
+    template<typename RingT>
+    void basic_radix2_domain<RingT>::iFFT(vector<RingT> &a) {
+        // The FFT with respect to omega^{-1} is the FFT with respect to omega, followed by reversing a[1..m-1]
+        FFT(a);
+        std::reverse(a.begin() + 1, a.end());
+        for (auto &a_i: a) {
+            a_i *= m_inv;
+        }
+    }
+
+    template<typename RingT>
+    RingT basic_radix2_domain<RingT>::compute_vanishing_polynomial(const RingT &t) const {
+        return power(t, this->m) - RingT::one();
+    }
+
+    template<typename RingT>
+    const vector<RingT> &basic_radix2_domain<RingT>::vanishing_polynomial() const {
+        return Z_coeffs;
+    }
+
+    template<typename RingT>
+    void basic_radix2_domain<RingT>::divide_by_Z_on_coset(vector<RingT> &P) const {
+        const size_t m = this->m;
+        if (P.size() <= m) {
+            P.clear();
+            return;
+        }
+        // P = Q * (z^m - 1) + R gives q_i = p_{i+m} + q_{i+m}, from the highest coefficient down
+        vector<RingT> Q(P.begin() + m, P.end());
+        for (size_t i = Q.size(); i-- > m;) {
+            Q[i - m] += Q[i];
+        }
+        P = std::move(Q);
+    }
+
+    template<typename RingT>
+    vector<RingT> basic_radix2_domain<RingT>::compute_quotient(const vector<RingT> &A,
+                                                               const vector<RingT> &B,
+                                                               const vector<RingT> &C) {
+        const size_t m = this->m;
+        if (A.size() > m || B.size() > m || C.size() > m) {
+            throw std::invalid_argument("expected polynomials with at most m coefficients");
+        }
+        vector<RingT> H(A), B_coset(B), C_coset(C);
+        H.resize(m, RingT::zero());
+        B_coset.resize(m, RingT::zero());
+        C_coset.resize(m, RingT::zero());
+
+        this->cosetFFT(H, coset_generator);
+        this->cosetFFT(B_coset, coset_generator);
+        this->cosetFFT(C_coset, coset_generator);
+        for (size_t i = 0; i < m; i++) {
+            H[i] *= B_coset[i];
+            H[i] -= C_coset[i];
+            H[i] *= Z_inv_on_coset;
+        }
+        this->icosetFFT(H, coset_generator);
+        return H;
+    }
+} // ringsnark
+
+#endif // BASIC_RADIX2_DOMAIN_TCC_
@@ -0,0 +1,51 @@
+/** @file
+ *****************************************************************************
+ Declaration of auxiliary functions for the "basic radix-2" evaluation domain.
+ These functions compute the radix-2 FFT, and are shared by the domain itself
+ and by FFT-based polynomial multiplication.
+ *****************************************************************************
+ * @author     This file is part of libfqfft, developed by SCIPR Lab
+ *             and contributors (see AUTHORS).
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#ifndef BASIC_RADIX2_DOMAIN_AUX_HPP_
+#define BASIC_RADIX2_DOMAIN_AUX_HPP_
+
+#include <type_traits>
+#include <vector>
+
+namespace ringsnark {
+
+    /**
+     * Whether RingT provides primitive roots of unity through a static RingT::get_root_of_unity(size_t order).
+     */
+    template<typename RingT, typename = void>
+    struct has_root_of_unity : std::false_type {
+    };
+
+    template<typename RingT>
+    struct has_root_of_unity<RingT, std::void_t<decltype(RingT::get_root_of_unity(size_t(0)))>> : std::true_type {
+    };
+
+    /**
+     * Compute the FFT of the vector a, of size m = 2^k, in place.
+     * omega_powers must hold omega^0,...,omega^{m/2-1} for a primitive m-th root of unity omega,
+     * or a longer prefix of the powers of omega.
+     */
+    template<typename RingT>
+    void _basic_radix2_FFT(std::vector<RingT> &a, const std::vector<RingT> &omega_powers);
+
+    /**
+     * Return omega^0,...,omega^{m/2-1} and m^{-1}, for omega = RingT::get_root_of_unity(m).
+     * The values are computed once per m and cached, since they only depend on the ring.
+     * If RingT has no primitive m-th root of unity, the powers are empty, which is cached as well.
+     */
+    template<typename RingT>
+    const std::pair<std::vector<RingT>, RingT> &_basic_radix2_twiddles(size_t m);
+
+} // ringsnark
+
+#include "basic_radix2_domain_aux.tcc"
+
+#endif // BASIC_RADIX2_DOMAIN_AUX_HPP_
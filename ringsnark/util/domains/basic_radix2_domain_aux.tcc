@@ -0,0 +1,86 @@
+/** @file
+ *****************************************************************************
+ Implementation of auxiliary functions for the "basic radix-2" evaluation domain.
+
+ See basic_radix2_domain_aux.hpp .
+ *****************************************************************************
+ * @author     This file is part of libfqfft, developed by SCIPR Lab
+ *             and contributors (see AUTHORS).
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#ifndef BASIC_RADIX2_DOMAIN_AUX_TCC_
+#define BASIC_RADIX2_DOMAIN_AUX_TCC_
+
+#include <map>
+#include <mutex>
+#include <stdexcept>
+
+namespace ringsnark {
+
+    template<typename RingT>
+    void _basic_radix2_FFT(std::vector<RingT> &a, const std::vector<RingT> &omega_powers) {
+        const size_t m = a.size();
+        if (m == 0 || (m & (m - 1)) != 0) {
+            throw std::invalid_argument("expected a vector whose size is a power of two");
+        }
+        size_t log_m = 0;
+        while ((size_t(1) << log_m) < m) { log_m++; }
+
+        for (size_t k = 0; k < m; k++) {
+            size_t rk = 0;
+            for (size_t i = 0, n = k; i < log_m; i++, n >>= 1) {
+                rk = (rk << 1) | (n & 1);
+            }
+            if (k < rk) {
+                std::swap(a[k], a[rk]);
+            }
+        }
+
+        // The twiddle factor omega_{2*half}^j is omega^{j * m / (2*half)}
+        RingT t;
+        for (size_t half = 1; half < m; half *= 2) {
+            const size_t stride = m / (2 * half);
+            for (size_t k = 0; k < m; k += 2 * half) {
+                for (size_t j = 0; j < half; j++) {
+                    t = a[k + j + half];
+                    if (j != 0) {
+                        t *= omega_powers[j * stride];
+                    }
+                    a[k + j + half] = a[k + j];
+                    a[k + j + half] -= t;
+                    a[k + j] += t;
+                }
+            }
+        }
+    }
+
+    template<typename RingT>
+    const std::pair<std::vector<RingT>, RingT> &_basic_radix2_twiddles(const size_t m) {
+        static std::map<size_t, std::pair<std::vector<RingT>, RingT>> cache;
+        static std::mutex cache_mutex;
+
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        auto it = cache.find(m);
+        if (it == cache.end()) {
+            std::vector<RingT> omega_powers;
+            RingT m_inv;
+            try {
+                const RingT omega = RingT::get_root_of_unity(m);
+                omega_powers.resize(std::max<size_t>(m / 2, 1));
+                omega_powers[0] = RingT::one();
+                for (size_t i = 1; i < omega_powers.size(); i++) {
+                    omega_powers[i] = omega_powers[i - 1] * omega;
+                }
+                m_inv = RingT::one() / RingT(m);
+            } catch (const std::invalid_argument &) {
+                // Cache the missing root as well, so that callers falling back to other methods do not retry
+            }
+            it = cache.emplace(m, std::make_pair(std::move(omega_powers), m_inv)).first;
+        }
+        return it->second;
+    }
+
+} // ringsnark
+
+#endif // BASIC_RADIX2_DOMAIN_AUX_TCC_
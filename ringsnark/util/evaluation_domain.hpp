@@ -24,6 +24,8 @@
 
 #include <vector>
 #include <memory>
+#include <mutex>
+#include "polynomials.hpp"
 
 using namespace std;
 
@@ -36,6 +38,25 @@ namespace ringsnark {
     class evaluation_domain {
     protected:
         vector<RingT> values;
+        // Barycentric weights of S, if known in closed form; otherwise they are taken from the subproduct tree
+        vector<RingT> weights;
+
+        // Memoised data, computed on first use. Domains are shared through get_evaluation_domain, so they are
+        // initialized at most once, even with concurrent callers.
+        mutable std::once_flag tree_flag, Z_rev_inv_flag;
+        mutable std::shared_ptr<subproduct_tree<RingT>> tree;
+        // Inverse of the reversal of Z modulo z^m
+        mutable vector<RingT> Z_rev_inv;
+
+        /**
+         * Construct an evaluation domain S with the given elements.
+         */
+        explicit evaluation_domain(vector<RingT> values);
+
+        /**
+         * Get the subproduct tree over S, building it on first use.
+         */
+        const subproduct_tree<RingT> &get_subproduct_tree() const;
 
     public:
         const size_t m;
@@ -47,64 +68,108 @@ namespace ringsnark {
          */
         explicit evaluation_domain(size_t m);
 
+        virtual ~evaluation_domain() = default;
+
         /**
          * Get the idx-th element in S.
          */
         RingT get_domain_element(const size_t idx) const;
 
-//        /**
-//         * Compute the FFT, over the domain S, of the vector a.
-//         */
-//        virtual void FFT(std::vector<RingT> &a) = 0;
-//
-//        /**
-//         * Compute the inverse FFT, over the domain S, of the vector a.
-//         */
-//        virtual void iFFT(std::vector<RingT> &a) = 0;
-//
-//        /**
-//         * Compute the FFT, over the domain g*S, of the vector a.
-//         */
-//        virtual void cosetFFT(std::vector<RingT> &a, const RingT &g) = 0;
-//
-//        /**
-//         * Compute the inverse FFT, over the domain g*S, of the vector a.
-//         */
-//        virtual void icosetFFT(std::vector<RingT> &a, const RingT &g) = 0;
+        /**
+         * Get all elements of S.
+         */
+        const vector<RingT> &get_domain_elements() const;
+
+        /**
+         * Get the barycentric weights of S, i.e., w_i = 1 / prod_{k != i} (a_i - a_k).
+         */
+        virtual const vector<RingT> &barycentric_weights() const;
+
+        /**
+         * Compute the FFT, over the domain S, of the vector a.
+         *
+         * The default implementation evaluates the polynomial with coefficients a at all elements of S using a
+         * subproduct tree, in O(m log^2 m) ring operations given fast polynomial multiplication.
+         */
+        virtual void FFT(std::vector<RingT> &a);
+
+        /**
+         * Compute the inverse FFT, over the domain S, of the vector a.
+         *
+         * The default implementation interpolates the evaluations a over S using a subproduct tree.
+         */
+        virtual void iFFT(std::vector<RingT> &a);
+
+        /**
+         * Compute the FFT, over the domain g*S, of the vector a.
+         */
+        virtual void cosetFFT(std::vector<RingT> &a, const RingT &g);
+
+        /**
+         * Compute the inverse FFT, over the domain g*S, of the vector a.
+         */
+        virtual void icosetFFT(std::vector<RingT> &a, const RingT &g);
 
         /**
          * Evaluate all Lagrange polynomials.
          *
+         * Uses the barycentric form L_{i,S}(t) = Z(t) * w_i / (t - a_i), i.e., one batch inversion of the
+         * differences (t - a_i) and O(m) ring operations.
+         *
          * The inputs are:
          * - an integer m
          * - an element t
          * The output is a vector (b_{0},...,b_{m-1})
          * where b_{i} is the evaluation of L_{i,S}(z) at z = t.
          */
-        std::vector<RingT> evaluate_all_lagrange_polynomials(const RingT &t) const;
+        virtual std::vector<RingT> evaluate_all_lagrange_polynomials(const RingT &t) const;
 
         /**
          * Evaluate the vanishing polynomial of S at the ring element t.
          */
-        RingT compute_vanishing_polynomial(const RingT &t) const;
+        virtual RingT compute_vanishing_polynomial(const RingT &t) const;
 
         /**
-        * Compute the coefficients of the vanishing polynomial of S.
+        * Get the coefficients of the vanishing polynomial of S.
         */
-        vector<RingT> vanishing_polynomial() const;
+        virtual const vector<RingT> &vanishing_polynomial() const;
 
         /**
          * Add the coefficients of the vanishing polynomial of S to the coefficients of the polynomial H.
          */
-        void add_poly_Z(const RingT &coeff, std::vector<RingT> &H) const;
+        virtual void add_poly_Z(const RingT &coeff, std::vector<RingT> &H) const;
 
         /**
          * Multiply by the evaluation, on a coset of S, of the inverse of the vanishing polynomial of S.
+         *
+         * The default implementation replaces P by the quotient P / Z, for P divisible by Z, using a precomputed
+         * inverse of the reversal of Z and a single polynomial multiplication.
          */
-        void divide_by_Z_on_coset(std::vector<RingT> &P) const;
+        virtual void divide_by_Z_on_coset(std::vector<RingT> &P) const;
+
+        /**
+         * Compute the coefficients of the quotient (A*B - C) / Z, given the coefficients of A, B and C.
+         */
+        virtual std::vector<RingT> compute_quotient(const std::vector<RingT> &A,
+                                                    const std::vector<RingT> &B,
+                                                    const std::vector<RingT> &C);
     };
 
 
+    template<typename RingT>
+    class basic_radix2_domain;
+
+    /**
+     * Return an evaluation domain of size at least min_size.
+     *
+     * Domains are cached by size, so that repeated calls (e.g., from the generator, prover and verifier of the same
+     * circuit) share the memoised vanishing polynomial, weights and subproduct tree.
+     *
+     * If RingT provides a primitive m-th root of unity, for m the smallest power of two of at least min_size, the
+     * domain is the multiplicative subgroup it generates (see basic_radix2_domain), which supports O(m log m) FFTs.
+     * Callers must then treat the m - min_size extra points as padding, e.g., as all-zero constraints.
+     * Otherwise, the domain is S = {0,...,min_size-1}.
+     */
     template<typename RingT>
     std::shared_ptr<evaluation_domain<RingT> > get_evaluation_domain(size_t min_size);
 
@@ -112,5 +177,6 @@ namespace ringsnark {
 }
 
 #include "evaluation_domain.tcc"
+#include "domains/basic_radix2_domain.hpp"
 
 #endif // EVALUATION_DOMAIN_HPP_
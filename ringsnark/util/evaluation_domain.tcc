@@ -1,6 +1,9 @@
 #include "polynomials.hpp"
+#include "ring_utils.hpp"
 #include <unordered_set>
 #include <stdexcept>
+#include <map>
+#include <mutex>
 
 namespace ringsnark {
     template<typename RingT>
@@ -8,31 +11,114 @@ namespace ringsnark {
         for (uint64_t i = 0; i < m; i++) {
             values[i] = RingT(i); // TODO: assert i is in exceptional set
         }
+        if (m == 0) {
+            return;
+        }
+
+        // For S = {0,...,m-1}, prod_{k != i} (i - k) = (-1)^{m-1-i} * i! * (m-1-i)!, so the weights only
+        // need the inverse factorials, which take a single inversion
+        vector<RingT> inv_fact(m);
+        inv_fact[0] = RingT::one();
+        for (uint64_t i = 1; i < m; i++) {
+            inv_fact[i] = inv_fact[i - 1] * values[i];
+        }
+        inv_fact[m - 1] = RingT::one() / inv_fact[m - 1];
+        for (uint64_t i = m - 1; i > 0; i--) {
+            inv_fact[i - 1] = inv_fact[i] * values[i];
+        }
+
+        weights.resize(m);
+        for (uint64_t i = 0; i < m; i++) {
+            weights[i] = inv_fact[i] * inv_fact[m - 1 - i];
+            if ((m - 1 - i) & 1) {
+                weights[i] = RingT::zero() - weights[i];
+            }
+        }
     }
 
+    template<typename RingT>
+    evaluation_domain<RingT>::evaluation_domain(vector<RingT> values) : values(std::move(values)),
+                                                                       m(this->values.size()) {}
+
     template<typename RingT>
     RingT evaluation_domain<RingT>::get_domain_element(const size_t idx) const {
         return values[idx];
     }
 
+    template<typename RingT>
+    const vector<RingT> &evaluation_domain<RingT>::get_domain_elements() const {
+        return values;
+    }
+
+    template<typename RingT>
+    const subproduct_tree<RingT> &evaluation_domain<RingT>::get_subproduct_tree() const {
+        std::call_once(tree_flag, [this]() { tree = std::make_shared<subproduct_tree<RingT>>(values, weights); });
+        return *tree;
+    }
+
+    template<typename RingT>
+    const vector<RingT> &evaluation_domain<RingT>::barycentric_weights() const {
+        if (!weights.empty()) {
+            return weights;
+        }
+        return get_subproduct_tree().get_weights();
+    }
+
+    template<typename RingT>
+    void evaluation_domain<RingT>::FFT(vector<RingT> &a) {
+        if (a.size() != m) {
+            throw std::invalid_argument("expected a vector of size m");
+        }
+        a = get_subproduct_tree().evaluate(a);
+    }
+
+    template<typename RingT>
+    void evaluation_domain<RingT>::iFFT(vector<RingT> &a) {
+        if (a.size() != m) {
+            throw std::invalid_argument("expected a vector of size m");
+        }
+        a = get_subproduct_tree().interpolate(a);
+    }
+
+    template<typename RingT>
+    void evaluation_domain<RingT>::cosetFFT(vector<RingT> &a, const RingT &g) {
+        // a(g*z) has coefficients a_i * g^i
+        RingT g_i = g;
+        for (size_t i = 1; i < a.size(); i++) {
+            a[i] *= g_i;
+            g_i *= g;
+        }
+        FFT(a);
+    }
+
+    template<typename RingT>
+    void evaluation_domain<RingT>::icosetFFT(vector<RingT> &a, const RingT &g) {
+        iFFT(a);
+        const RingT g_inv = RingT::one() / g;
+        RingT g_inv_i = g_inv;
+        for (size_t i = 1; i < a.size(); i++) {
+            a[i] *= g_inv_i;
+            g_inv_i *= g_inv;
+        }
+    }
+
     template<typename RingT>
     vector<RingT> evaluation_domain<RingT>::evaluate_all_lagrange_polynomials(const RingT &t) const {
         if (std::find(values.begin(), values.end(), t) != values.end()) {
             throw std::invalid_argument("t cannot be one of the values in the domain");
         }
-        // TODO: Optimize
-        // lagrange[j] = \prod_{i=0,i!=j}^m (t-x_i) / (x_j-x_i)
+        const vector<RingT> &w = barycentric_weights();
+
+        // lagrange[i] = Z(t) * w_i / (t - x_i)
         vector<RingT> lagrange(m);
-        for (int j = 0; j < m; j++) {
-            lagrange[j] = RingT::one();
-            RingT denominator = RingT::one();
-            for (int i = 0; i < m; i++) {
-                if (i != j) {
-                    lagrange[j] *= (t - values[i]);
-                    denominator *= (values[j] - values[i]);
-                }
-            }
-            lagrange[j] /= denominator;
+        for (size_t i = 0; i < m; i++) {
+            lagrange[i] = t - values[i];
+        }
+        batch_invert(lagrange);
+        const RingT Z_t = compute_vanishing_polynomial(t);
+        for (size_t i = 0; i < m; i++) {
+            lagrange[i] *= Z_t;
+            lagrange[i] *= w[i];
         }
         return lagrange;
     }
@@ -47,17 +133,14 @@ namespace ringsnark {
     }
 
     template<typename RingT>
-    vector<RingT> evaluation_domain<RingT>::vanishing_polynomial() const {
-        polynomial<RingT> Z_poly(vector<RingT>{-values[0], RingT::one()});
-        for (size_t i = 1; i < values.size(); i++) {
-            Z_poly *= polynomial<RingT>(vector<RingT>{-values[i], RingT::one()});
-        }
-        return Z_poly.data();
+    const vector<RingT> &evaluation_domain<RingT>::vanishing_polynomial() const {
+        // Z is the root of the subproduct tree
+        return get_subproduct_tree().vanishing_polynomial();
     }
 
     template<typename RingT>
     void evaluation_domain<RingT>::add_poly_Z(const RingT &coeff, vector<RingT> &H) const {
-        vector<RingT> Z = vanishing_polynomial();
+        const vector<RingT> &Z = vanishing_polynomial();
 
         for (size_t i = 0; i < std::min(H.size(), Z.size()); i++) {
             H[i] += coeff * Z[i];
@@ -74,14 +157,67 @@ namespace ringsnark {
     // TODO: not sure if we are technically dividing on coset, we might be using a misleading method name at the moment.
     template<typename RingT>
     void evaluation_domain<RingT>::divide_by_Z_on_coset(vector<RingT> &P) const {
-        // implementation also normalizes P, i.e., strips zero higher coefficients
-        P = divide(P, vanishing_polynomial());
+        const vector<RingT> &Z = vanishing_polynomial();
+        std::call_once(Z_rev_inv_flag, [this, &Z]() {
+            // Z is monic, so inverting its reversal needs no inversions in RingT
+            Z_rev_inv = inverse_series(vector<RingT>(Z.rbegin(), Z.rend()), m);
+        });
+        P = quotient_monic(P, Z, Z_rev_inv);
+    }
+
+    template<typename RingT>
+    vector<RingT> evaluation_domain<RingT>::compute_quotient(const vector<RingT> &A,
+                                                             const vector<RingT> &B,
+                                                             const vector<RingT> &C) {
+        auto H = multiply(A, B);
+        if (H.size() < C.size()) {
+            H.resize(C.size(), RingT::zero());
+        }
+        for (size_t i = 0; i < C.size(); i++) {
+            H[i] -= C[i];
+        }
+        divide_by_Z_on_coset(H);
+        return H;
     }
 
     template<typename RingT>
     shared_ptr<evaluation_domain<RingT>> get_evaluation_domain(const size_t min_size) {
-        shared_ptr<evaluation_domain<RingT>>
-                shared_domain(new evaluation_domain<RingT>(min_size));
+        static std::map<size_t, shared_ptr<evaluation_domain<RingT>>> cache;
+        static std::mutex cache_mutex;
+
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        auto it = cache.find(min_size);
+        if (it != cache.end()) {
+            return it->second;
+        }
+
+        shared_ptr<evaluation_domain<RingT>> shared_domain;
+        if constexpr (has_root_of_unity<RingT>::value) {
+            if (min_size > 1) {
+                // Round up to the next power of two, so that sizes in between share the radix-2 domain
+                size_t m = 2;
+                while (m < min_size) {
+                    m <<= 1;
+                }
+                const auto it_m = cache.find(m);
+                if (it_m != cache.end()) {
+                    if (std::dynamic_pointer_cast<basic_radix2_domain<RingT>>(it_m->second)) {
+                        shared_domain = it_m->second;
+                    }
+                } else {
+                    try {
+                        shared_domain.reset(new basic_radix2_domain<RingT>(m));
+                        cache.emplace(m, shared_domain);
+                    } catch (const std::invalid_argument &) {
+                        // No root of unity of this order or no coset generator, fall back to the generic domain
+                    }
+                }
+            }
+        }
+        if (!shared_domain) {
+            shared_domain.reset(new evaluation_domain<RingT>(min_size));
+        }
+        cache.emplace(min_size, shared_domain);
         return shared_domain;
     }
 }
\ No newline at end of file
@@ -0,0 +1,161 @@
+#include <gtest/gtest.h>
+
+#include "polynomials.hpp"
+#include "seal/seal.h"
+#include "../seal/seal_ring.hpp"
+#include "evaluation_domain.hpp"
+
+using ringsnark::seal::RingElem;
+
+::seal::SEALContext get_context() {
+    ::seal::EncryptionParameters params(::seal::scheme_type::bgv);
+    auto poly_modulus_degree = (size_t) pow(2, 10);
+    params.set_poly_modulus_degree(poly_modulus_degree);
+    params.set_coeff_modulus(::seal::CoeffModulus::Create(poly_modulus_degree, {30, 30}));
+    params.set_plain_modulus(::seal::PlainModulus::Batching(poly_modulus_degree, 20));
+    ::seal::SEALContext context(params);
+    return context;
+}
+
+namespace {
+    TEST(FFTTest, TestRadix2DomainSelection) {
+        // Sizes are rounded up to the next power of two
+        for (size_t n: {12, 16}) {
+            auto domain = ringsnark::get_evaluation_domain<RingElem>(n);
+            EXPECT_NE(std::dynamic_pointer_cast<ringsnark::basic_radix2_domain<RingElem>>(domain), nullptr);
+            EXPECT_EQ(domain->m, 16);
+        }
+
+        // The coefficient moduli are 1 mod 2^11 but not mod 2^12, so there is no primitive 4096-th root of unity
+        auto domain = ringsnark::get_evaluation_domain<RingElem>(3000);
+        EXPECT_EQ(std::dynamic_pointer_cast<ringsnark::basic_radix2_domain<RingElem>>(domain), nullptr);
+        EXPECT_EQ(domain->m, 3000);
+    }
+
+    TEST(FFTTest, TestDomainCache) {
+        auto domain = ringsnark::get_evaluation_domain<RingElem>(12);
+        EXPECT_EQ(domain, ringsnark::get_evaluation_domain<RingElem>(12));
+        EXPECT_EQ(domain, ringsnark::get_evaluation_domain<RingElem>(13));
+        EXPECT_NE(domain, ringsnark::get_evaluation_domain<RingElem>(17));
+
+        // Memoised data is computed once and then shared
+        EXPECT_EQ(&domain->vanishing_polynomial(), &domain->vanishing_polynomial());
+        const auto &weights = domain->barycentric_weights();
+        for (size_t i = 0; i < domain->m; i++) {
+            RingElem prod = RingElem::one();
+            for (size_t j = 0; j < domain->m; j++) {
+                if (j != i) {
+                    prod *= domain->get_domain_element(i) - domain->get_domain_element(j);
+                }
+            }
+            EXPECT_EQ(weights[i] * prod, RingElem::one());
+        }
+    }
+
+    TEST(FFTTest, TestTwiddlesCache) {
+        EXPECT_FALSE(ringsnark::_basic_radix2_twiddles<RingElem>(16).first.empty());
+
+        // A missing root of unity is cached as empty powers, instead of being looked up (and thrown) again
+        const auto &twiddles = ringsnark::_basic_radix2_twiddles<RingElem>(4096);
+        EXPECT_TRUE(twiddles.first.empty());
+        EXPECT_EQ(&twiddles, &ringsnark::_basic_radix2_twiddles<RingElem>(4096));
+
+        // Products that would need such an FFT fall back to Karatsuba
+        const vector<RingElem> x(2048, RingElem::one()), y(64, RingElem::one());
+        const vector<RingElem> xy = multiply(x, y);
+        ASSERT_EQ(xy.size(), 2111);
+        EXPECT_EQ(xy[0], RingElem::one());
+        EXPECT_EQ(xy[100], RingElem(64));
+        EXPECT_EQ(xy[2110], RingElem::one());
+    }
+
+    TEST(FFTTest, TestFFT) {
+        size_t n = 16;
+        auto domain = ringsnark::get_evaluation_domain<RingElem>(n);
+        vector<RingElem> coeffs(n);
+        for (size_t i = 0; i < n; i++) {
+            coeffs[i] = RingElem::random_element();
+        }
+
+        vector<RingElem> evals(coeffs);
+        domain->FFT(evals);
+        for (size_t i = 0; i < n; i++) {
+            EXPECT_EQ(evals[i], eval(coeffs, domain->get_domain_element(i)));
+        }
+
+        domain->iFFT(evals);
+        for (size_t i = 0; i < n; i++) {
+            EXPECT_EQ(evals[i], coeffs[i]);
+        }
+    }
+
+    TEST(FFTTest, TestQuotient) {
+        size_t n = 16;
+        auto domain = ringsnark::get_evaluation_domain<RingElem>(n);
+        vector<RingElem> A(n), B(n), C(n);
+        for (size_t i = 0; i < n; i++) {
+            A[i] = RingElem::random_element();
+            B[i] = RingElem::random_element();
+            C[i] = A[i] * B[i];
+        }
+        domain->iFFT(A);
+        domain->iFFT(B);
+        domain->iFFT(C);
+
+        vector<RingElem> H = domain->compute_quotient(A, B, C);
+        for (size_t i = 0; i < 4; i++) {
+            RingElem s = RingElem::random_element();
+            EXPECT_EQ(eval(A, s) * eval(B, s) - eval(C, s), eval(H, s) * domain->compute_vanishing_polynomial(s));
+        }
+    }
+
+    TEST(FFTTest, TestLagrangePolynomials) {
+        // Generic domain (closed-form weights) and radix-2 domain (weights omega^i / m)
+        for (const auto &domain: {std::make_shared<ringsnark::evaluation_domain<RingElem>>(12),
+                                  ringsnark::get_evaluation_domain<RingElem>(16)}) {
+            const size_t n = domain->m;
+            vector<RingElem> coeffs(n);
+            for (auto &c_i: coeffs) {
+                c_i = RingElem::random_element();
+            }
+
+            RingElem s = RingElem::random_element();
+            vector<RingElem> lagrange = domain->evaluate_all_lagrange_polynomials(s);
+            RingElem res_interpolated = RingElem::zero();
+            for (size_t i = 0; i < n; i++) {
+                res_interpolated += eval(coeffs, domain->get_domain_element(i)) * lagrange[i];
+            }
+            EXPECT_EQ(res_interpolated, eval(coeffs, s));
+
+            EXPECT_THROW(domain->evaluate_all_lagrange_polynomials(domain->get_domain_element(1)),
+                         std::invalid_argument);
+        }
+    }
+
+    TEST(FFTTest, TestDivideByZ) {
+        // Generic domain (Newton division) and radix-2 domain (division by z^m - 1)
+        for (const auto &domain: {std::make_shared<ringsnark::evaluation_domain<RingElem>>(12),
+                                  ringsnark::get_evaluation_domain<RingElem>(16)}) {
+            const size_t n = domain->m;
+            vector<RingElem> quotient(n - 1);
+            for (auto &q_i: quotient) {
+                q_i = RingElem::random_element();
+            }
+
+            vector<RingElem> P = multiply(quotient, domain->vanishing_polynomial());
+            domain->divide_by_Z_on_coset(P);
+            ASSERT_EQ(P.size(), quotient.size());
+            for (size_t i = 0; i < quotient.size(); i++) {
+                EXPECT_EQ(P[i], quotient[i]);
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    ::seal::SEALContext context = get_context();
+    ringsnark::seal::RingElem::set_context(context);
+
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -81,6 +81,49 @@ namespace {
         }
     }
 
+    TYPED_TEST(InterpolationTest, TestSubproductTree) {
+        size_t n = 7;
+        vector<TypeParam> coeffs(n);
+        vector<TypeParam> x(n);
+        for (size_t i = 0; i < n; i++) {
+            coeffs[i] = (i == 0) ? TypeParam::one() : coeffs[i - 1] + TypeParam::one();
+            x[i] = TypeParam(i);
+        }
+
+        subproduct_tree<TypeParam> tree(x);
+        vector<TypeParam> y = tree.evaluate(coeffs);
+        for (size_t i = 0; i < n; i++) {
+            EXPECT_EQ(y[i], eval(coeffs, x[i]));
+        }
+
+        vector<TypeParam> coeffs_interpolated = tree.interpolate(y);
+        for (size_t i = 0; i < n; i++) {
+            EXPECT_EQ(coeffs_interpolated[i], coeffs[i]);
+        }
+    }
+
+    TEST(SubproductTreeTest, TestLargeDomain) {
+        // Large enough to take the Newton division path for the upper levels of the tree
+        using RingT = ringsnark::seal::RingElem;
+        size_t n = 100;
+        vector<RingT> coeffs(n);
+        vector<RingT> x(n);
+        for (size_t i = 0; i < n; i++) {
+            coeffs[i] = RingT::random_element();
+            x[i] = RingT(i);
+        }
+
+        subproduct_tree<RingT> tree(x);
+        vector<RingT> y = tree.evaluate(coeffs);
+        for (size_t i = 0; i < n; i++) {
+            EXPECT_EQ(y[i], eval(coeffs, x[i]));
+        }
+
+        vector<RingT> coeffs_interpolated = tree.interpolate(y);
+        for (size_t i = 0; i < n; i++) {
+            EXPECT_EQ(coeffs_interpolated[i], coeffs[i]);
+        }
+    }
 }
 
 int main(int argc, char **argv) {
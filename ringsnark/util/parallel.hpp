@@ -0,0 +1,33 @@
+/** @file
+ *****************************************************************************
+ Declaration of helpers to split work across threads.
+ *****************************************************************************/
+
+#ifndef RINGSNARK_PARALLEL_HPP_
+#define RINGSNARK_PARALLEL_HPP_
+
+#include <cstddef>
+#include <vector>
+
+namespace ringsnark {
+
+    /**
+     * Call f(i) for all i in [0, n), using up to num_threads threads (including the calling one).
+     * Indices are split into contiguous chunks, one per thread. If some call throws, the first exception is rethrown
+     * once all threads have finished.
+     */
+    template<typename F>
+    void parallel_for(size_t n, size_t num_threads, F f);
+
+    /**
+     * Return the sum of all elements of vec, computed by a balanced tree of pairwise additions whose levels are
+     * spread across up to num_threads threads. Requires vec to be non-empty; vec is consumed.
+     */
+    template<typename T>
+    T parallel_sum(std::vector<T> &vec, size_t num_threads);
+
+} // ringsnark
+
+#include "parallel.tcc"
+
+#endif // RINGSNARK_PARALLEL_HPP_
@@ -0,0 +1,73 @@
+/** @file
+ *****************************************************************************
+ Implementation of helpers to split work across threads.
+
+ See parallel.hpp .
+ *****************************************************************************/
+
+#ifndef RINGSNARK_PARALLEL_TCC_
+#define RINGSNARK_PARALLEL_TCC_
+
+#include <algorithm>
+#include <cassert>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+namespace ringsnark {
+
+    template<typename F>
+    void parallel_for(const size_t n, size_t num_threads, F f) {
+        num_threads = std::max<size_t>(1, std::min(num_threads, n));
+        if (num_threads == 1) {
+            for (size_t i = 0; i < n; i++) {
+                f(i);
+            }
+            return;
+        }
+
+        std::exception_ptr error;
+        std::mutex error_mutex;
+        auto run_chunk = [&](const size_t t) {
+            try {
+                for (size_t i = t * n / num_threads; i < (t + 1) * n / num_threads; i++) {
+                    f(i);
+                }
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+        };
+
+        std::vector<std::thread> workers;
+        workers.reserve(num_threads - 1);
+        for (size_t t = 1; t < num_threads; t++) {
+            workers.emplace_back(run_chunk, t);
+        }
+        run_chunk(0);
+        for (auto &worker: workers) {
+            worker.join();
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    template<typename T>
+    T parallel_sum(std::vector<T> &vec, const size_t num_threads) {
+        assert(!vec.empty());
+        // At each level, vec[i] += vec[i + stride] for all i that are multiples of 2*stride
+        for (size_t stride = 1; stride < vec.size(); stride *= 2) {
+            const size_t num_pairs = (vec.size() - stride + 2 * stride - 1) / (2 * stride);
+            parallel_for(num_pairs, num_threads, [&vec, stride](const size_t j) {
+                vec[2 * stride * j] += vec[2 * stride * j + stride];
+            });
+        }
+        return vec[0];
+    }
+
+} // ringsnark
+
+#endif // RINGSNARK_PARALLEL_TCC_
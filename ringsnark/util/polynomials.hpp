@@ -37,6 +37,95 @@ vector<RingT> add(const vector<RingT> &x, const vector<RingT> &y);
 template<typename RingT>
 vector<RingT> divide(const vector<RingT> &numerator, const vector<RingT> &denominator);
 
+/**
+ * Return the inverse of the power series f modulo z^n, computed by Newton iteration.
+ * Requires f[0] to be invertible. No other inversions are performed, so if f[0] is one, none at all.
+ * @tparam RingT
+ * @param f coefficients of the power series
+ * @param n precision of the result
+ * @return coefficients `g' of size n, such that f * g = 1 mod z^n
+ */
+template<typename RingT>
+vector<RingT> inverse_series(const vector<RingT> &f, size_t n);
+
+/**
+ * Return the quotient of the division of `p' by the monic polynomial `m', using a single multiplication.
+ * @tparam RingT
+ * @param p
+ * @param m monic polynomial of degree d
+ * @param rev_m_inv inverse of the reversal z^d m(1/z) modulo z^{deg(p) - d + 1} (see inverse_series),
+ *        recomputed if it has fewer coefficients
+ * @return coefficients of the quotient, of size p.size() - d (empty if p.size() <= d)
+ */
+template<typename RingT>
+vector<RingT> quotient_monic(const vector<RingT> &p, const vector<RingT> &m, const vector<RingT> &rev_m_inv);
+
+/**
+ * Return the remainder of the division of `p' by the monic polynomial `m', using two multiplications.
+ * @tparam RingT
+ * @param p
+ * @param m monic polynomial of degree d
+ * @param rev_m_inv inverse of the reversal z^d m(1/z) modulo z^{deg(p) - d + 1} (see inverse_series),
+ *        recomputed if it has fewer coefficients
+ * @return coefficients of the remainder, of size min(p.size(), d)
+ */
+template<typename RingT>
+vector<RingT> remainder_monic(const vector<RingT> &p, const vector<RingT> &m, const vector<RingT> &rev_m_inv);
+
+/**
+ * A subproduct tree over the points x_0,...,x_{n-1}, for multipoint evaluation and interpolation.
+ *
+ * The leaves are the polynomials (z - x_i) and every inner node is the product of its children, so the root is
+ * M(z) = prod_i (z - x_i). Building the tree costs O(M(n) log n), where M(n) is the cost of multiplying two
+ * polynomials of degree n. Evaluation and interpolation then cost O(M(n) log n) each.
+ * The tree is meant to be built once per set of points and reused across calls, and is immutable once built.
+ */
+template<typename RingT>
+class subproduct_tree {
+public:
+    /**
+     * Build the tree over the points x. The barycentric weights of the points are computed from the tree, unless
+     * they are given in `weights', e.g., from a closed form.
+     */
+    explicit subproduct_tree(const vector<RingT> &x, vector<RingT> weights = {});
+
+    [[nodiscard]] size_t size() const { return levels[0].size(); }
+
+    /**
+     * Return the coefficients of M(z) = prod_i (z - x_i).
+     */
+    const vector<RingT> &vanishing_polynomial() const { return levels.back()[0]; }
+
+    /**
+     * Return the evaluations f(x_0),...,f(x_{n-1}) of the polynomial f with coefficients `coeffs'.
+     */
+    vector<RingT> evaluate(const vector<RingT> &coeffs) const;
+
+    /**
+     * Return the barycentric weights 1 / M'(x_i) = 1 / prod_{j != i} (x_i - x_j).
+     */
+    const vector<RingT> &get_weights() const { return weights; }
+
+    /**
+     * Return the coefficients of the degree-(n-1) polynomial f with f(x_i) = y[i].
+     */
+    vector<RingT> interpolate(const vector<RingT> &y) const;
+
+private:
+    // Nodes below this degree are reduced by schoolbook division, which is cheaper for small degrees
+    static constexpr size_t newton_threshold = 32;
+
+    // levels[0][i] = z - x_i, and levels[k][j] = levels[k-1][2j] * levels[k-1][2j+1],
+    // or levels[k-1][2j] if it has no sibling
+    vector<vector<vector<RingT>>> levels;
+    // rev_inverses[k][j] is the inverse of the reversal of levels[k][j], for nodes of degree >= newton_threshold
+    vector<vector<vector<RingT>>> rev_inverses;
+    // weights[i] = 1 / M'(x_i)
+    vector<RingT> weights;
+
+    vector<RingT> reduce(const vector<RingT> &p, size_t level, size_t idx) const;
+};
+
 #include "polynomials.tcc"
 
 #endif //RINGSNARK_INTERPOLATION_H
@@ -1,6 +1,8 @@
 #include <algorithm>
 #include <cstdint>
 #include <boost/math/tools/polynomial.hpp>
+#include "domains/basic_radix2_domain_aux.hpp"
+#include "ring_utils.hpp"
 
 using size_t = std::size_t;
 template<typename RingT>
@@ -11,7 +13,7 @@ vector<RingT> interpolate(const vector<RingT> &x, const vector<RingT> &y) {
     assert(x.size() == y.size());
     int n = x.size();
     int k, j, i;
-    RingT phi, ff, b;
+    RingT ff, b;
 
     vector<RingT> coeffs(n, RingT::zero());
     vector<RingT> s(n, RingT::zero());
@@ -23,14 +25,19 @@ vector<RingT> interpolate(const vector<RingT> &x, const vector<RingT> &y) {
         }
         s[n - 1] -= x[i];
     }
+    // phi[j] = M'(x[j]), inverted all at once
+    vector<RingT> phi(n);
     for (j = 0; j < n; j++) {
-        phi = RingT(n);
+        phi[j] = RingT(n);
         for (k = n - 1; k > 0; k--) {
             // phi = RingT(k) * s[k] + x[j] * phi;
-            phi *= x[j];
-            phi += s[k] * RingT(k);
+            phi[j] *= x[j];
+            phi[j] += s[k] * RingT(k);
         }
-        ff = y[j] / phi;
+    }
+    ringsnark::batch_invert(phi);
+    for (j = 0; j < n; j++) {
+        ff = y[j] * phi[j];
         b = RingT::one();
         for (k = n - 1; k >= 0; k--) {
             // b = s[k] + x[j] * b;
@@ -57,19 +64,157 @@ inline bool is_zero(const vector<RingT> &coeffs) {
     return std::all_of(coeffs.begin(), coeffs.end(), [](const RingT &c) { return c.is_zero(); });
 }
 
+namespace {
+    // Below this size, schoolbook multiplication beats Karatsuba
+    constexpr size_t karatsuba_threshold = 16;
+    // From this size on, multiplication through radix-2 FFTs beats Karatsuba, if RingT provides roots of unity
+    constexpr size_t fft_multiplication_threshold = 32;
+
+    size_t karatsuba_scratch_size(const size_t n) {
+        if (n < karatsuba_threshold) {
+            return 0;
+        }
+        const size_t hh = n - n / 2;
+        return 4 * hh - 1 + karatsuba_scratch_size(hh);
+    }
+
+    /**
+     * Set r[0..2n-1) to the product of a[0..n) and b[0..n).
+     * scratch must hold karatsuba_scratch_size(n) elements, tmp is a temporary reused for products.
+     */
+    template<typename RingT>
+    void karatsuba(const RingT *a, const RingT *b, const size_t n, RingT *r, RingT *scratch, RingT &tmp) {
+        if (n < karatsuba_threshold) {
+            std::fill(r, r + 2 * n - 1, RingT::zero());
+            for (size_t i = 0; i < n; i++) {
+                for (size_t j = 0; j < n; j++) {
+                    tmp = a[i];
+                    tmp *= b[j];
+                    r[i + j] += tmp;
+                }
+            }
+            return;
+        }
+
+        // a = a0 + z^h a1, b = b0 + z^h b1, where a0, b0 have h and a1, b1 have hh >= h coefficients
+        const size_t h = n / 2, hh = n - h;
+        RingT *sa = scratch, *sb = scratch + hh, *z1 = scratch + 2 * hh, *rest = scratch + 4 * hh - 1;
+
+        // r = a0 b0 + z^{2h} a1 b1
+        karatsuba(a, b, h, r, rest, tmp);
+        r[2 * h - 1] = RingT::zero();
+        karatsuba(a + h, b + h, hh, r + 2 * h, rest, tmp);
+
+        // z1 = (a0 + a1)(b0 + b1) - a0 b0 - a1 b1
+        for (size_t i = 0; i < hh; i++) {
+            sa[i] = a[h + i];
+            sb[i] = b[h + i];
+            if (i < h) {
+                sa[i] += a[i];
+                sb[i] += b[i];
+            }
+        }
+        karatsuba(sa, sb, hh, z1, rest, tmp);
+        for (size_t i = 0; i < 2 * h - 1; i++) {
+            z1[i] -= r[i];
+        }
+        for (size_t i = 0; i < 2 * hh - 1; i++) {
+            z1[i] -= r[2 * h + i];
+        }
+
+        for (size_t i = 0; i < 2 * hh - 1; i++) {
+            r[h + i] += z1[i];
+        }
+    }
+
+    /**
+     * Multiply x and y by FFTs of size m, a power of two no smaller than the size of the product, with the twiddle
+     * factors omega_powers and m_inv from _basic_radix2_twiddles(m).
+     */
+    template<typename RingT>
+    vector<RingT> multiply_fft(const vector<RingT> &x, const vector<RingT> &y, const size_t m,
+                               const vector<RingT> &omega_powers, const RingT &m_inv) {
+        const size_t res_size = x.size() + y.size() - 1;
+
+        vector<RingT> fx(x), fy(y);
+        fx.resize(m, RingT::zero());
+        fy.resize(m, RingT::zero());
+        ringsnark::_basic_radix2_FFT(fx, omega_powers);
+        ringsnark::_basic_radix2_FFT(fy, omega_powers);
+        for (size_t i = 0; i < m; i++) {
+            fx[i] *= fy[i];
+        }
+
+        // The FFT with respect to omega^{-1} is the FFT with respect to omega, followed by reversing fx[1..m-1]
+        ringsnark::_basic_radix2_FFT(fx, omega_powers);
+        std::reverse(fx.begin() + 1, fx.end());
+        fx.resize(res_size);
+        for (auto &c: fx) {
+            c *= m_inv;
+        }
+        return fx;
+    }
+}
+
 template<typename RingT>
 vector<RingT> multiply(const vector<RingT> &x, const vector<RingT> &y) {
-    polynomial<RingT> x_poly(x), y_poly(y);
-    x_poly *= y_poly;
-    return x_poly.data();
+    if (x.empty() || y.empty()) {
+        return {};
+    }
+    const size_t n_short = std::min(x.size(), y.size()), n_long = std::max(x.size(), y.size());
+    const RingT *a = (x.size() >= y.size()) ? x.data() : y.data();
+    const RingT *b = (x.size() >= y.size()) ? y.data() : x.data();
+
+    if constexpr (ringsnark::has_root_of_unity<RingT>::value) {
+        if (n_short >= fft_multiplication_threshold) {
+            size_t m = 1;
+            while (m < x.size() + y.size() - 1) { m *= 2; }
+            const auto &[omega_powers, m_inv] = ringsnark::_basic_radix2_twiddles<RingT>(m);
+            // Empty if there are no roots of unity of the required order, then fall back to Karatsuba
+            if (!omega_powers.empty()) {
+                return multiply_fft(x, y, m, omega_powers, m_inv);
+            }
+        }
+    }
 
+    vector<RingT> res(x.size() + y.size() - 1, RingT::zero());
+    RingT tmp;
+    if (n_short < karatsuba_threshold) {
+        for (size_t i = 0; i < n_long; i++) {
+            for (size_t j = 0; j < n_short; j++) {
+                tmp = a[i];
+                tmp *= b[j];
+                res[i + j] += tmp;
+            }
+        }
+        return res;
+    }
+
+    // Multiply the shorter factor with blocks of the longer one, all scratch space is allocated once
+    vector<RingT> scratch(karatsuba_scratch_size(n_short) + 2 * n_short - 1);
+    vector<RingT> block_a(n_short);
+    RingT *block_res = scratch.data() + karatsuba_scratch_size(n_short);
+    for (size_t offset = 0; offset < n_long; offset += n_short) {
+        const size_t len = std::min(n_short, n_long - offset);
+        for (size_t i = 0; i < n_short; i++) {
+            block_a[i] = (i < len) ? a[offset + i] : RingT::zero();
+        }
+        karatsuba(block_a.data(), b, n_short, block_res, scratch.data(), tmp);
+        for (size_t i = 0; i < std::min(2 * n_short - 1, res.size() - offset); i++) {
+            res[offset + i] += block_res[i];
+        }
+    }
+    return res;
 }
 
 template<typename RingT>
 vector<RingT> add(const vector<RingT> &x, const vector<RingT> &y) {
-    polynomial<RingT> x_poly(x), y_poly(y);
-    x_poly += y_poly;
-    return x_poly.data();
+    vector<RingT> res(x.size() >= y.size() ? x : y);
+    const vector<RingT> &shorter = (x.size() >= y.size()) ? y : x;
+    for (size_t i = 0; i < shorter.size(); i++) {
+        res[i] += shorter[i];
+    }
+    return res;
 }
 
 template<typename RingT>
@@ -77,4 +222,185 @@ vector<RingT> divide(const vector<RingT> &numerator, const vector<RingT> &denomi
     polynomial<RingT> x_poly(numerator), y_poly(denominator);
     x_poly /= y_poly;
     return x_poly.data();
-}
\ No newline at end of file
+}
+
+template<typename RingT>
+vector<RingT> inverse_series(const vector<RingT> &f, const size_t n) {
+    assert(!f.empty() && n > 0);
+    vector<RingT> g{RingT::one() / f[0]};
+    g.reserve(n);
+    // If f * g = 1 mod z^k, then g - g * (f * g - 1) is the inverse of f modulo z^{2k}
+    for (size_t k = 1; k < n;) {
+        const size_t k_next = std::min(2 * k, n);
+        vector<RingT> f_trunc(f.begin(), f.begin() + std::min(f.size(), k_next));
+        vector<RingT> e = multiply(f_trunc, g);
+        e.resize(k_next, RingT::zero());
+        // The lower k coefficients of f * g - 1 are zero
+        vector<RingT> e_high(e.begin() + k, e.end());
+        vector<RingT> correction = multiply(g, e_high);
+        correction.resize(k_next - k, RingT::zero());
+        for (size_t i = 0; i < k_next - k; i++) {
+            g.push_back(RingT::zero() - correction[i]);
+        }
+        k = k_next;
+    }
+    return g;
+}
+
+template<typename RingT>
+vector<RingT> quotient_monic(const vector<RingT> &p, const vector<RingT> &m, const vector<RingT> &rev_m_inv) {
+    const size_t d = m.size() - 1;
+    if (p.size() <= d) {
+        return {};
+    }
+    // p = q * m + r, with rev(q) = rev(p) * rev(m)^{-1} mod z^k
+    const size_t k = p.size() - d;
+    vector<RingT> rev_p(p.rbegin(), p.rbegin() + k);
+    vector<RingT> rev_q;
+    if (rev_m_inv.size() >= k) {
+        rev_q = multiply(rev_p, vector<RingT>(rev_m_inv.begin(), rev_m_inv.begin() + k));
+    } else {
+        rev_q = multiply(rev_p, inverse_series(vector<RingT>(m.rbegin(), m.rend()), k));
+    }
+    rev_q.resize(k, RingT::zero());
+    return vector<RingT>(rev_q.rbegin(), rev_q.rend());
+}
+
+template<typename RingT>
+vector<RingT> remainder_monic(const vector<RingT> &p, const vector<RingT> &m, const vector<RingT> &rev_m_inv) {
+    const size_t d = m.size() - 1;
+    if (p.size() <= d) {
+        return p;
+    }
+    vector<RingT> qm = multiply(quotient_monic(p, m, rev_m_inv), m);
+    qm.resize(d, RingT::zero());
+    vector<RingT> r(p.begin(), p.begin() + d);
+    for (size_t i = 0; i < d; i++) {
+        r[i] -= qm[i];
+    }
+    return r;
+}
+
+template<typename RingT>
+subproduct_tree<RingT>::subproduct_tree(const vector<RingT> &x, vector<RingT> weights) : weights(std::move(weights)) {
+    assert(!x.empty());
+    assert(this->weights.empty() || this->weights.size() == x.size());
+    vector<vector<RingT>> leaves;
+    leaves.reserve(x.size());
+    for (const auto &x_i: x) {
+        leaves.push_back({RingT::zero() - x_i, RingT::one()});
+    }
+    levels.push_back(std::move(leaves));
+    while (levels.back().size() > 1) {
+        const auto &prev = levels.back();
+        vector<vector<RingT>> next;
+        next.reserve((prev.size() + 1) / 2);
+        for (size_t j = 0; 2 * j < prev.size(); j++) {
+            if (2 * j + 1 < prev.size()) {
+                next.push_back(multiply(prev[2 * j], prev[2 * j + 1]));
+            } else {
+                next.push_back(prev[2 * j]);
+            }
+        }
+        levels.push_back(std::move(next));
+    }
+
+    // The root is never used as a divisor, since evaluated polynomials have degree < n
+    rev_inverses.resize(levels.size());
+    for (size_t k = 0; k + 1 < levels.size(); k++) {
+        rev_inverses[k].resize(levels[k].size());
+        for (size_t j = 0; j < levels[k].size(); j++) {
+            const auto &node = levels[k][j];
+            if (node.size() - 1 >= newton_threshold) {
+                rev_inverses[k][j] = inverse_series(vector<RingT>(node.rbegin(), node.rend()), node.size() - 1);
+            }
+        }
+    }
+
+    if (this->weights.empty()) {
+        const auto &M = vanishing_polynomial();
+        vector<RingT> M_prime(M.size() - 1);
+        for (size_t i = 1; i < M.size(); i++) {
+            M_prime[i - 1] = M[i] * RingT(i);
+        }
+        this->weights = evaluate(M_prime);
+        ringsnark::batch_invert(this->weights);
+    }
+}
+
+template<typename RingT>
+vector<RingT> subproduct_tree<RingT>::reduce(const vector<RingT> &p, const size_t level, const size_t idx) const {
+    const auto &node = levels[level][idx];
+    const size_t d = node.size() - 1;
+    if (p.size() <= d) {
+        return p;
+    }
+    if (!rev_inverses[level].empty() && !rev_inverses[level][idx].empty()) {
+        return remainder_monic(p, node, rev_inverses[level][idx]);
+    }
+    // Schoolbook division by a monic polynomial
+    vector<RingT> r(p);
+    for (size_t i = r.size() - 1; i >= d; i--) {
+        for (size_t j = 0; j < d; j++) {
+            r[i - d + j] -= r[i] * node[j];
+        }
+        if (i == d) { break; }
+    }
+    r.resize(d);
+    return r;
+}
+
+template<typename RingT>
+vector<RingT> subproduct_tree<RingT>::evaluate(const vector<RingT> &coeffs) const {
+    // Reduce modulo the nodes from the root down, so that the remainder at leaf i is f mod (z - x_i) = f(x_i)
+    vector<vector<RingT>> remainders{reduce(coeffs, levels.size() - 1, 0)};
+    for (size_t k = levels.size() - 1; k-- > 0;) {
+        vector<vector<RingT>> next(levels[k].size());
+        for (size_t j = 0; j < levels[k].size(); j++) {
+            next[j] = reduce(remainders[j / 2], k, j);
+        }
+        remainders = std::move(next);
+    }
+
+    vector<RingT> evals(size(), RingT::zero());
+    for (size_t i = 0; i < size(); i++) {
+        if (!remainders[i].empty()) {
+            evals[i] = remainders[i][0];
+        }
+    }
+    return evals;
+}
+
+template<typename RingT>
+vector<RingT> subproduct_tree<RingT>::interpolate(const vector<RingT> &y) const {
+    assert(y.size() == size());
+
+    // f = sum_i y_i / M'(x_i) * M(z) / (z - x_i), accumulated from the leaves up
+    vector<vector<RingT>> polys(size());
+    for (size_t i = 0; i < size(); i++) {
+        polys[i] = {y[i] * weights[i]};
+    }
+    for (size_t k = 1; k < levels.size(); k++) {
+        const auto &children = levels[k - 1];
+        vector<vector<RingT>> next(levels[k].size());
+        for (size_t j = 0; j < levels[k].size(); j++) {
+            if (2 * j + 1 < children.size()) {
+                next[j] = multiply(polys[2 * j], children[2 * j + 1]);
+                const vector<RingT> right = multiply(polys[2 * j + 1], children[2 * j]);
+                if (next[j].size() < right.size()) {
+                    next[j].resize(right.size(), RingT::zero());
+                }
+                for (size_t i = 0; i < right.size(); i++) {
+                    next[j][i] += right[i];
+                }
+            } else {
+                next[j] = std::move(polys[2 * j]);
+            }
+        }
+        polys = std::move(next);
+    }
+
+    vector<RingT> coeffs = std::move(polys[0]);
+    coeffs.resize(size(), RingT::zero());
+    return coeffs;
+}
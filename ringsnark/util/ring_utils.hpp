@@ -0,0 +1,50 @@
+/** @file
+ *****************************************************************************
+ Declaration of utility functions over rings, e.g., batch inversion.
+ *****************************************************************************/
+
+#ifndef RINGSNARK_RING_UTILS_HPP_
+#define RINGSNARK_RING_UTILS_HPP_
+
+#include <vector>
+#include <type_traits>
+
+namespace ringsnark {
+
+    /**
+     * Whether RingT provides a static RingT::batch_invert(std::vector<RingT> &), which inverts the invertible elements
+     * in place and returns the indices of the non-invertible ones.
+     */
+    template<typename RingT, typename = void>
+    struct has_batch_inversion : std::false_type {
+    };
+
+    template<typename RingT>
+    struct has_batch_inversion<RingT, std::void_t<decltype(RingT::batch_invert(std::declval<std::vector<RingT> &>()))>>
+            : std::true_type {
+    };
+
+    /**
+     * Whether T provides a T::Multiplier, i.e., a scalar prepared once for multiplying several Ts, with T *= T::Multiplier.
+     */
+    template<typename T, typename = void>
+    struct has_prepared_multiplier : std::false_type {
+    };
+
+    template<typename T>
+    struct has_prepared_multiplier<T, std::void_t<typename T::Multiplier>> : std::true_type {
+    };
+
+    /**
+     * Invert all elements of vec in place, using Montgomery's trick: a single inversion of the product of all
+     * elements, plus 3(k-1) multiplications for k elements. Uses RingT::batch_invert if available.
+     * Throws std::invalid_argument if some element is not invertible, in which case vec is left unchanged.
+     */
+    template<typename RingT>
+    void batch_invert(std::vector<RingT> &vec);
+
+} // ringsnark
+
+#include "ring_utils.tcc"
+
+#endif // RINGSNARK_RING_UTILS_HPP_
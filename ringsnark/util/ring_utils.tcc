@@ -0,0 +1,53 @@
+/** @file
+ *****************************************************************************
+ Implementation of utility functions over rings.
+
+ See ring_utils.hpp .
+ *****************************************************************************/
+
+#ifndef RINGSNARK_RING_UTILS_TCC_
+#define RINGSNARK_RING_UTILS_TCC_
+
+#include <stdexcept>
+#include <string>
+
+namespace ringsnark {
+
+    template<typename RingT>
+    void batch_invert(std::vector<RingT> &vec) {
+        if (vec.empty()) {
+            return;
+        }
+        if constexpr (has_batch_inversion<RingT>::value) {
+            std::vector<RingT> res(vec);
+            const auto non_invertible = RingT::batch_invert(res);
+            if (!non_invertible.empty()) {
+                throw std::invalid_argument(
+                        "element " + std::to_string(non_invertible.front()) + " is not invertible in ring");
+            }
+            vec = std::move(res);
+            return;
+        }
+        // prefix[i] = vec[0] * ... * vec[i-1]
+        std::vector<RingT> prefix;
+        prefix.reserve(vec.size());
+        RingT acc = RingT::one();
+        for (const auto &el: vec) {
+            prefix.push_back(acc);
+            acc *= el;
+        }
+
+        // Throws if the product, and hence some element, is not invertible
+        RingT acc_inv = RingT::one() / acc;
+
+        for (size_t i = vec.size(); i-- > 0;) {
+            // acc_inv = (vec[0] * ... * vec[i])^{-1}
+            RingT old_el = vec[i];
+            vec[i] = acc_inv * prefix[i];
+            acc_inv *= old_el;
+        }
+    }
+
+} // ringsnark
+
+#endif // RINGSNARK_RING_UTILS_TCC_
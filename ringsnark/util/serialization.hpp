@@ -0,0 +1,65 @@
+/** @file
+ *****************************************************************************
+ Declaration of helpers for binary serialization.
+ *****************************************************************************/
+
+#ifndef RINGSNARK_SERIALIZATION_HPP_
+#define RINGSNARK_SERIALIZATION_HPP_
+
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace ringsnark {
+
+    /**
+     * Write v to out as 8 bytes, in the byte order of the machine.
+     */
+    inline void write_uint64(std::ostream &out, const uint64_t v) {
+        out.write(reinterpret_cast<const char *>(&v), sizeof(v));
+    }
+
+    /**
+     * Read a value written by write_uint64. Throws std::invalid_argument if in ends before.
+     */
+    inline uint64_t read_uint64(std::istream &in) {
+        uint64_t v;
+        if (!in.read(reinterpret_cast<char *>(&v), sizeof(v))) {
+            throw std::invalid_argument("unexpected end of stream");
+        }
+        return v;
+    }
+
+    /**
+     * Write the magic string, e.g., the name and version of a file format, to out.
+     */
+    inline void write_magic(std::ostream &out, const std::string &magic) {
+        out.write(magic.data(), static_cast<std::streamsize>(magic.size()));
+    }
+
+    /**
+     * Read the magic string written by write_magic. Throws std::invalid_argument if in does not start with it.
+     */
+    inline void read_magic(std::istream &in, const std::string &magic) {
+        std::string res(magic.size(), '\0');
+        if (!in.read(res.data(), static_cast<std::streamsize>(res.size())) || res != magic) {
+            throw std::invalid_argument("unexpected data in stream, expected " + magic);
+        }
+    }
+
+    /**
+     * The 64-bit FNV-1a hash of data, e.g., for naming files after the objects they were derived from.
+     */
+    inline uint64_t fnv1a_hash(const std::string &data) {
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        for (const char c: data) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 0x100000001b3ULL;
+        }
+        return hash;
+    }
+
+} // ringsnark
+
+#endif // RINGSNARK_SERIALIZATION_HPP_
@@ -1,6 +1,7 @@
 #ifndef GROTH16_HPP
 #define GROTH16_HPP
 
+#include <ringsnark/reductions/r1cs_to_qrp/r1cs_to_qrp.hpp>
 #include <ringsnark/zk_proof_systems/r1cs_ppzksnark.hpp>
 
 using std::vector;
@@ -35,10 +36,10 @@ namespace ringsnark::groth16 {
                 delta_mid(delta_mid),
                 delta_ts(delta_ts),
                 pk_enc(pk_enc) {
-            assert(s_pows.size() == constraint_system.num_constraints() + 1);
+            assert(s_pows.size() == r1cs_to_qrp_degree(constraint_system) + 1);
             assert(gamma_io.size() == constraint_system.primary_input_size+1);
             assert(delta_mid.size() == constraint_system.auxiliary_input_size);
-            assert(delta_ts.size() == constraint_system.num_constraints() + 1);
+            assert(delta_ts.size() == r1cs_to_qrp_degree(constraint_system) + 1);
         }
 
         [[nodiscard]] size_t size_in_bits() const override {
@@ -1,6 +1,18 @@
 #include <ringsnark/reductions/r1cs_to_qrp/r1cs_to_qrp.hpp>
+#include <ringsnark/util/ring_utils.hpp>
 
 namespace ringsnark::groth16 {
+    /**
+     * Set up the encoding contexts of EncT with the smallest parameters that leave enough noise budget for proofs
+     * about cs (see EncodingElem::set_context), instead of a fixed choice.
+     */
+    template<typename RingT, typename EncT>
+    void set_encoding_context(const r1cs_constraint_system<RingT> &cs) {
+        // A and B add up two inner products of length d and one more term; C adds up d+1 and n_aux products
+        const size_t d = r1cs_to_qrp_degree(cs);
+        EncT::set_context(std::max(2 * d + 1, d + 1 + cs.auxiliary_input_size), 1);
+    }
+
     template<typename RingT, typename EncT>
     keypair<RingT, EncT> generator(const r1cs_constraint_system<RingT> &cs) {
         const RingT s = RingT::random_exceptional_element();
@@ -13,13 +25,15 @@ namespace ringsnark::groth16 {
                 gamma = RingT::random_invertible_element(),
                 delta = RingT::random_invertible_element();
         // TODO: get inverse directly from generation, since it has to be computed anyway?
-        const RingT gamma_inv = RingT::one() / gamma;
-        const RingT delta_inv = RingT::one() / delta;
+        vector<RingT> inverses{gamma, delta};
+        batch_invert(inverses);
+        const RingT gamma_inv = inverses[0];
+        const RingT delta_inv = inverses[1];
 
         // ({E(s^i)}_{i=0}^{num_mid}}, {E(alpha * s^i)}_{i=0}^{num_mid}}, {beta_prod}_{i=0}^{num_mid}, pk)
         // Ht holds the monomials {s^i}_{i=0}^m
 
-        vector<RingT> s_pows_ring(qrp_inst.Ht.begin(), qrp_inst.Ht.begin() + cs.num_constraints() + 1);
+        vector<RingT> s_pows_ring(qrp_inst.Ht.begin(), qrp_inst.Ht.begin() + qrp_inst.degree() + 1);
         vector<RingT> delta_ts_ring(s_pows_ring);
         for (auto &s_i: delta_ts_ring) {
             s_i *= qrp_inst.Zt;
@@ -81,8 +95,7 @@ namespace ringsnark::groth16 {
                                                                    primary_input, auxiliary_input,
                                                                    RingT::zero(), RingT::zero(), RingT::zero());
 
-        // TODO: this is highly non-optimized, skip all the zero-multiplication
-        // s_pows have length d+1, where d = cs.num_constraints() is the size of the QRP
+        // s_pows have length d+1, where d is the degree of the QRP
         auto a = qrp_wit.coefficients_for_A_io;
         EncT a_enc = inner_product<EncT, RingT>(pk.s_pows.begin(), pk.s_pows.end() - 1,
                                                 a.begin(), a.end());
@@ -125,18 +138,16 @@ namespace ringsnark::groth16 {
         vector<RingT> padded_primary_assignment(primary_input);
         vector<RingT> zeros(vk.pk.constraint_system.auxiliary_input_size, RingT::zero());
         padded_primary_assignment.insert(padded_primary_assignment.end(), zeros.begin(), zeros.end());
-        vector<RingT> v_io(cs.num_constraints()), w_io(cs.num_constraints()), y_io(cs.num_constraints());
+        auto domain = get_evaluation_domain<RingT>(cs.num_constraints());
+        vector<RingT> v_io(domain->m, RingT::zero()), w_io(domain->m, RingT::zero()), y_io(domain->m, RingT::zero());
         for (size_t i = 0; i < cs.num_constraints(); ++i) {
             v_io[i] = cs.constraints[i].a.evaluate(padded_primary_assignment);
             w_io[i] = cs.constraints[i].b.evaluate(padded_primary_assignment);
             y_io[i] = cs.constraints[i].c.evaluate(padded_primary_assignment);
         }
-        auto domain = get_evaluation_domain<RingT>(cs.num_constraints());
-        vector<RingT> xs(domain->m);
-        for (size_t i = 0; i < domain->m; i++) { xs[i] = domain->get_domain_element(i); }
-        v_io = interpolate(xs, v_io);
-        w_io = interpolate(xs, w_io);
-        y_io = interpolate(xs, y_io);
+        domain->iFFT(v_io);
+        domain->iFFT(w_io);
+        domain->iFFT(y_io);
 
         auto v_io_s = eval(v_io, vk.s);
         auto w_io_s = eval(w_io, vk.s);
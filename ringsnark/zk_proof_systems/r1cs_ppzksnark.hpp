@@ -53,6 +53,8 @@ namespace ringsnark {
     public:
         proving_key() = default;
 
+        virtual ~proving_key() = default;
+
         [[nodiscard]] virtual size_t size_in_bits() const = 0;
     };
 
@@ -77,6 +79,8 @@ namespace ringsnark {
     template<typename RingT, typename EncT>
     class verification_key {
     public:
+        virtual ~verification_key() = default;
+
         [[nodiscard]] virtual size_t size_in_bits() const = 0;
     };
 
@@ -102,6 +106,9 @@ namespace ringsnark {
     template<typename RingT, typename EncT>
     class processed_verification_key {
     public:
+        virtual ~processed_verification_key() = default;
+
+        [[nodiscard]] virtual size_t size_in_bits() const = 0;
     };
 
 
@@ -151,6 +158,7 @@ namespace ringsnark {
     template<typename RingT, typename EncT>
     class proof {
     public:
+        virtual ~proof() = default;
 
         [[nodiscard]] virtual size_t size_in_bits() const = 0;
 
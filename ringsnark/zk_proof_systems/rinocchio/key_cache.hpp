@@ -0,0 +1,64 @@
+/** @file
+ *****************************************************************************
+ Declaration of binary serialization for Rinocchio keys, and of a directory of cached keypairs.
+ *****************************************************************************/
+
+#ifndef RINOCCHIO_KEY_CACHE_HPP
+#define RINOCCHIO_KEY_CACHE_HPP
+
+#include <iostream>
+#include <string>
+
+#include <ringsnark/zk_proof_systems/rinocchio/rinocchio.hpp>
+
+namespace ringsnark::rinocchio {
+    /**
+     * Binary serialization of the keys, with RingT::save/load for ring elements, EncT::save/load for encodings,
+     * and EncT::save_pk/load_pk, EncT::save_sk/load_sk for the keys of the encoding scheme.
+     * The encoding contexts must be set up as for generating the keys before loading them.
+     * Loading throws std::invalid_argument if the data is malformed or does not match the contexts.
+     */
+    template<typename RingT, typename EncT>
+    void save_proving_key(std::ostream &out, const proving_key<RingT, EncT> &pk);
+
+    template<typename RingT, typename EncT>
+    proving_key<RingT, EncT> load_proving_key(std::istream &in);
+
+    /**
+     * The verification key is saved together with the proving key it holds.
+     */
+    template<typename RingT, typename EncT>
+    void save_verification_key(std::ostream &out, const verification_key<RingT, EncT> &vk);
+
+    template<typename RingT, typename EncT>
+    verification_key<RingT, EncT> load_verification_key(std::istream &in);
+
+    /**
+     * A hexadecimal hash of cs, the parameters of RingT and EncT, and the options of the generator, which names the
+     * file of the corresponding keypair in a key cache directory.
+     */
+    template<typename RingT, typename EncT>
+    std::string key_cache_id(const r1cs_constraint_system<RingT> &cs, bool lagrange_basis = false,
+                             bool packed = false, bool legacy_layout = false);
+
+    /**
+     * Like generator, but first look for the keys in cache_dir, and store newly generated ones there, so that
+     * repeated runs of the same circuit under the same parameters skip key generation.
+     * A cached keypair is only used if its constraint system equals cs; a missing, unreadable or mismatching
+     * file is regenerated. The encodings are stored in seed-compressed form (see generator). Failing to store
+     * the keys does not fail the call, which then returns the generated keys all the same.
+     *
+     * The cached keys include the trapdoor (s, alpha, beta, r_v, r_w, r_y) and the secret key of the encoding scheme,
+     * with which anyone can forge proofs. So cache_dir is created accessible by its owner only (mode 0700), the
+     * files are created readable by their owner only (mode 0600), and if cache_dir exists but is accessible by its
+     * group or others, the cache is not used at all.
+     */
+    template<typename RingT, typename EncT>
+    keypair<RingT, EncT> cached_generator(const std::string &cache_dir, const r1cs_constraint_system<RingT> &cs,
+                                          bool lagrange_basis = false, bool packed = false,
+                                          bool legacy_layout = false, size_t num_threads = 1);
+}
+
+#include "key_cache.tcc"
+
+#endif
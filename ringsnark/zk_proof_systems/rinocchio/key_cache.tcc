@@ -0,0 +1,217 @@
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <system_error>
+
+#include <ringsnark/util/serialization.hpp>
+
+namespace ringsnark::rinocchio {
+    namespace {
+        const std::string KEY_FILE_MAGIC = "RINOCCHIO-KEYS-V1";
+
+        /**
+         * Create dir with access for its owner only (mode 0700) if it does not exist, and return whether it is
+         * a directory that only its owner can access, i.e., that may hold the trapdoor of keys.
+         */
+        inline bool make_private_directory(const std::filesystem::path &dir) {
+            namespace fs = std::filesystem;
+            std::error_code ec;
+            if (fs::create_directories(dir, ec)) {
+                fs::permissions(dir, fs::perms::owner_all, fs::perm_options::replace, ec);
+            }
+            const fs::file_status status = fs::status(dir, ec);
+            return !ec && fs::is_directory(status)
+                   && (status.permissions() & (fs::perms::group_all | fs::perms::others_all)) == fs::perms::none;
+        }
+
+        template<typename EncT>
+        void save_encodings(std::ostream &out, const vector<EncT> &es) {
+            write_uint64(out, es.size());
+            for (const auto &e: es) {
+                e.save(out);
+            }
+        }
+
+        template<typename EncT>
+        vector<EncT> load_encodings(std::istream &in) {
+            const size_t size = read_uint64(in);
+            vector<EncT> es;
+            es.reserve(size);
+            for (size_t i = 0; i < size; i++) {
+                es.push_back(EncT::load(in));
+            }
+            return es;
+        }
+
+        template<typename EncT>
+        void save_optional_encoding(std::ostream &out, const std::optional<EncT> &e) {
+            write_uint64(out, e.has_value());
+            if (e.has_value()) {
+                e->save(out);
+            }
+        }
+
+        template<typename EncT>
+        std::optional<EncT> load_optional_encoding(std::istream &in) {
+            if (read_uint64(in) == 0) {
+                return std::nullopt;
+            }
+            return EncT::load(in);
+        }
+    }
+
+    template<typename RingT, typename EncT>
+    void save_proving_key(std::ostream &out, const proving_key<RingT, EncT> &pk) {
+        write_uint64(out, pk.packed);
+        save_r1cs_constraint_system(out, pk.constraint_system);
+        save_encodings(out, pk.s_pows);
+        save_encodings(out, pk.alpha_s_pows);
+        save_encodings(out, pk.beta_prods);
+        pk.beta_rv_ts.save(out);
+        pk.beta_rw_ts.save(out);
+        pk.beta_ry_ts.save(out);
+        save_optional_encoding(out, pk.alpha_rv_ts);
+        save_optional_encoding(out, pk.alpha_rw_ts);
+        save_optional_encoding(out, pk.alpha_ry_ts);
+        save_encodings(out, pk.rv_vs);
+        save_encodings(out, pk.rw_ws);
+        save_encodings(out, pk.ry_ys);
+        EncT::save_pk(out, pk.pk_enc);
+        save_encodings(out, pk.lagrange_s);
+        save_encodings(out, pk.alpha_lagrange_s);
+    }
+
+    template<typename RingT, typename EncT>
+    proving_key<RingT, EncT> load_proving_key(std::istream &in) {
+        // Function arguments are evaluated in unspecified order, so read the fields one by one
+        const bool packed = read_uint64(in);
+        const auto cs = load_r1cs_constraint_system<RingT>(in);
+        const auto s_pows = load_encodings<EncT>(in);
+        const auto alpha_s_pows = load_encodings<EncT>(in);
+        const auto beta_prods = load_encodings<EncT>(in);
+        const auto beta_rv_ts = EncT::load(in);
+        const auto beta_rw_ts = EncT::load(in);
+        const auto beta_ry_ts = EncT::load(in);
+        const auto alpha_rv_ts = load_optional_encoding<EncT>(in);
+        const auto alpha_rw_ts = load_optional_encoding<EncT>(in);
+        const auto alpha_ry_ts = load_optional_encoding<EncT>(in);
+        const auto rv_vs = load_encodings<EncT>(in);
+        const auto rw_ws = load_encodings<EncT>(in);
+        const auto ry_ys = load_encodings<EncT>(in);
+        const auto pk_enc = EncT::load_pk(in);
+        const auto lagrange_s = load_encodings<EncT>(in);
+        const auto alpha_lagrange_s = load_encodings<EncT>(in);
+
+        // The proving key only asserts its sizes, so check them here for untrusted input
+        const size_t k = packed ? EncT::packing_factor() : 1;
+        const auto num_encodings = [k](const size_t n) { return (n + k - 1) / k; };
+        if (s_pows.size() != num_encodings(r1cs_to_qrp_degree(cs) + 1) || alpha_s_pows.size() != s_pows.size() ||
+            beta_prods.size() != num_encodings(cs.auxiliary_input_size) ||
+            alpha_rw_ts.has_value() != alpha_rv_ts.has_value() || alpha_ry_ts.has_value() != alpha_rv_ts.has_value() ||
+            rv_vs.size() != (alpha_rv_ts.has_value() ? beta_prods.size() : 0) ||
+            rw_ws.size() != rv_vs.size() || ry_ys.size() != rv_vs.size() ||
+            (!lagrange_s.empty() && lagrange_s.size() != num_encodings(r1cs_to_qrp_degree(cs))) ||
+            alpha_lagrange_s.size() != lagrange_s.size()) {
+            throw std::invalid_argument("proving key does not match its constraint system");
+        }
+        return proving_key<RingT, EncT>(cs, s_pows, alpha_s_pows, beta_prods,
+                                        beta_rv_ts, beta_rw_ts, beta_ry_ts,
+                                        alpha_rv_ts, alpha_rw_ts, alpha_ry_ts,
+                                        rv_vs, rw_ws, ry_ys,
+                                        pk_enc,
+                                        lagrange_s, alpha_lagrange_s,
+                                        packed);
+    }
+
+    template<typename RingT, typename EncT>
+    void save_verification_key(std::ostream &out, const verification_key<RingT, EncT> &vk) {
+        save_proving_key(out, vk.pk);
+        for (const RingT *r: {&vk.s, &vk.alpha, &vk.beta, &vk.r_v, &vk.r_w, &vk.r_y}) {
+            r->save(out);
+        }
+        EncT::save_sk(out, vk.sk_enc);
+    }
+
+    template<typename RingT, typename EncT>
+    verification_key<RingT, EncT> load_verification_key(std::istream &in) {
+        const auto pk = load_proving_key<RingT, EncT>(in);
+        const RingT s = RingT::load(in), alpha = RingT::load(in), beta = RingT::load(in),
+                r_v = RingT::load(in), r_w = RingT::load(in), r_y = RingT::load(in);
+        return verification_key<RingT, EncT>(pk, s, alpha, beta, r_v, r_w, r_y, EncT::load_sk(in));
+    }
+
+    template<typename RingT, typename EncT>
+    std::string key_cache_id(const r1cs_constraint_system<RingT> &cs, const bool lagrange_basis, const bool packed,
+                             const bool legacy_layout) {
+        std::ostringstream data;
+        write_magic(data, KEY_FILE_MAGIC);
+        write_uint64(data, lagrange_basis);
+        write_uint64(data, packed);
+        write_uint64(data, legacy_layout);
+        RingT::save_parameters(data);
+        EncT::save_parameters(data);
+        save_r1cs_constraint_system(data, cs);
+
+        std::ostringstream id;
+        id << std::hex << std::setw(16) << std::setfill('0') << fnv1a_hash(data.str());
+        return id.str();
+    }
+
+    template<typename RingT, typename EncT>
+    keypair<RingT, EncT> cached_generator(const std::string &cache_dir, const r1cs_constraint_system<RingT> &cs,
+                                          const bool lagrange_basis, const bool packed, const bool legacy_layout,
+                                          const size_t num_threads) {
+        namespace fs = std::filesystem;
+        if (!make_private_directory(cache_dir)) {
+            return generator<RingT, EncT>(cs, lagrange_basis, packed, legacy_layout, num_threads);
+        }
+        const fs::path path = fs::path(cache_dir) / ("rinocchio-" + key_cache_id<RingT, EncT>(
+                cs, lagrange_basis, packed, legacy_layout) + ".keys");
+
+        std::ifstream in(path, std::ios::binary);
+        if (in) {
+            try {
+                read_magic(in, KEY_FILE_MAGIC);
+                auto vk = std::make_unique<verification_key<RingT, EncT>>(load_verification_key<RingT, EncT>(in));
+                if (vk->pk.constraint_system == cs) {
+                    // Like generator, hand out keys that outlive the keypair
+                    auto pk = new proving_key<RingT, EncT>(vk->pk);
+                    return keypair<RingT, EncT>(*pk, *vk.release());
+                }
+            } catch (const std::exception &) {
+                // Fall through and overwrite the file
+            }
+        }
+
+        const auto keys = generator<RingT, EncT>(cs, lagrange_basis, packed, legacy_layout, num_threads, true);
+        // Write to a temporary file of this run first, so that concurrent runs never read a partially written file
+        std::random_device rd;
+        std::ostringstream suffix;
+        suffix << "." << std::hex << std::setw(16) << std::setfill('0')
+               << ((uint64_t(rd()) << 32) | uint64_t(rd())) << ".tmp";
+        const fs::path tmp_path = fs::path(path).concat(suffix.str());
+        try {
+            std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+            if (!out) {
+                throw std::runtime_error("cannot create key cache file " + tmp_path.string());
+            }
+            // The file holds the trapdoor of the keys, so restrict it to the owner before writing to it
+            fs::permissions(tmp_path, fs::perms::owner_read | fs::perms::owner_write, fs::perm_options::replace);
+            write_magic(out, KEY_FILE_MAGIC);
+            save_verification_key(out, keys.vk);
+            out.close();
+            if (!out) {
+                throw std::runtime_error("cannot write key cache file " + tmp_path.string());
+            }
+            fs::rename(tmp_path, path);
+        } catch (const std::exception &) {
+            // The cache only saves time, so failing to fill it does not fail the run
+            std::error_code ec;
+            fs::remove(tmp_path, ec);
+        }
+        return keys;
+    }
+}
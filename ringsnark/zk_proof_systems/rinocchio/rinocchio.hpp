@@ -1,6 +1,9 @@
 #ifndef RINOCCHIO_HPP
 #define RINOCCHIO_HPP
 
+#include <optional>
+
+#include <ringsnark/reductions/r1cs_to_qrp/r1cs_to_qrp.hpp>
 #include <ringsnark/zk_proof_systems/r1cs_ppzksnark.hpp>
 
 using std::vector;
@@ -15,18 +18,29 @@ namespace ringsnark::rinocchio {
         const vector<EncT> s_pows, alpha_s_pows;
         const vector<EncT> beta_prods;
         const EncT beta_rv_ts, beta_rw_ts, beta_ry_ts;
-        const EncT alpha_rv_ts, alpha_rw_ts, alpha_ry_ts; // Unused?
-        const vector<EncT> rv_vs, rw_ws, ry_ys; // Unused?
+        // {E(alpha * r_* * Z(s))} and {E(r_* * *_i(s))}, which the prover does not read;
+        // empty unless the key was generated with legacy_layout set
+        const std::optional<EncT> alpha_rv_ts, alpha_rw_ts, alpha_ry_ts;
+        const vector<EncT> rv_vs, rw_ws, ry_ys;
         const PublicKey pk_enc;
+        // {E(L_i(s))}_{i=0}^{d-1}, {E(alpha * L_i(s))}_{i=0}^{d-1} for the Lagrange polynomials L_i of the QRP domain;
+        // empty unless the key was generated with lagrange_basis set
+        const vector<EncT> lagrange_s, alpha_lagrange_s;
+        // Whether the vectors above are encoded in packed form (see EncT::encode_packed), in which case pk_enc holds
+        // the keys to fold packed inner products
+        const bool packed;
 
         proving_key(const ringsnark::r1cs_constraint_system<RingT> &constraint_system,
                     const vector<EncT> &s_pows,
                     const vector<EncT> &alpha_s_pows,
                     const vector<EncT> &beta_prods,
                     const EncT beta_rv_ts, const EncT beta_rw_ts, const EncT beta_ry_ts,
-                    const EncT alpha_rv_ts, const EncT alpha_rw_ts, const EncT alpha_ry_ts,
-                    const vector<EncT> rv_vs, const vector<EncT> rw_ws, const vector<EncT> ry_ys,
-                    const PublicKey &pk_enc) :
+                    const std::optional<EncT> &alpha_rv_ts, const std::optional<EncT> &alpha_rw_ts,
+                    const std::optional<EncT> &alpha_ry_ts,
+                    const vector<EncT> &rv_vs, const vector<EncT> &rw_ws, const vector<EncT> &ry_ys,
+                    const PublicKey &pk_enc,
+                    const vector<EncT> &lagrange_s = {}, const vector<EncT> &alpha_lagrange_s = {},
+                    const bool packed = false) :
                 constraint_system(constraint_system),
                 s_pows(s_pows),
                 alpha_s_pows(alpha_s_pows),
@@ -34,18 +48,54 @@ namespace ringsnark::rinocchio {
                 beta_rv_ts(beta_rv_ts), beta_rw_ts(beta_rw_ts), beta_ry_ts(beta_ry_ts),
                 alpha_rv_ts(alpha_rv_ts), alpha_rw_ts(alpha_rw_ts), alpha_ry_ts(alpha_ry_ts),
                 rv_vs(rv_vs), rw_ws(rw_ws), ry_ys(ry_ys),
-                pk_enc(pk_enc) {
-            assert(s_pows.size() == constraint_system.num_constraints() + 1);
-            assert(alpha_s_pows.size() == constraint_system.num_constraints() + 1);
-            assert(beta_prods.size() == constraint_system.auxiliary_input_size);
+                pk_enc(pk_enc),
+                lagrange_s(lagrange_s), alpha_lagrange_s(alpha_lagrange_s),
+                packed(packed) {
+            assert(s_pows.size() == num_encodings(r1cs_to_qrp_degree(constraint_system) + 1));
+            assert(alpha_s_pows.size() == s_pows.size());
+            assert(beta_prods.size() == num_encodings(constraint_system.auxiliary_input_size));
+            assert(lagrange_s.empty() || lagrange_s.size() == num_encodings(r1cs_to_qrp_degree(constraint_system)));
+            assert(alpha_lagrange_s.size() == lagrange_s.size());
+            assert(has_legacy_layout() == alpha_rw_ts.has_value() && has_legacy_layout() == alpha_ry_ts.has_value());
+            assert(rv_vs.size() == (has_legacy_layout() ? beta_prods.size() : 0));
+            assert(rw_ws.size() == rv_vs.size() && ry_ys.size() == rv_vs.size());
+        }
+
+        /**
+         * The number of encodings holding n consecutive elements of one of the vectors above.
+         */
+        [[nodiscard]] size_t num_encodings(const size_t n) const {
+            const size_t k = packed ? EncT::packing_factor() : 1;
+            return (n + k - 1) / k;
+        }
+
+        [[nodiscard]] bool has_lagrange_basis() const {
+            return !lagrange_s.empty();
+        }
+
+        [[nodiscard]] bool has_legacy_layout() const {
+            return alpha_rv_ts.has_value();
         }
 
         [[nodiscard]] size_t size_in_bits() const override {
-            return s_pows.size() * s_pows[0].size_in_bits()
-                   + alpha_s_pows.size() * alpha_s_pows[0].size_in_bits()
-                   + beta_prods.size() * beta_prods[0].size_in_bits()
-                   + beta_rv_ts.size_in_bits() + beta_rw_ts.size_in_bits() + beta_ry_ts.size_in_bits()
-                   + EncT::size_in_bits_pk(pk_enc);
+            size_t size = s_pows.size() * s_pows[0].size_in_bits()
+                          + alpha_s_pows.size() * alpha_s_pows[0].size_in_bits()
+                          + beta_prods.size() * beta_prods[0].size_in_bits()
+                          + beta_rv_ts.size_in_bits() + beta_rw_ts.size_in_bits() + beta_ry_ts.size_in_bits()
+                          + EncT::size_in_bits_pk(pk_enc);
+            if (has_lagrange_basis()) {
+                size += lagrange_s.size() * lagrange_s[0].size_in_bits()
+                        + alpha_lagrange_s.size() * alpha_lagrange_s[0].size_in_bits();
+            }
+            if (has_legacy_layout()) {
+                size += alpha_rv_ts->size_in_bits() + alpha_rw_ts->size_in_bits() + alpha_ry_ts->size_in_bits();
+                for (const auto *vs: {&rv_vs, &rw_ws, &ry_ys}) {
+                    for (const auto &v: *vs) {
+                        size += v.size_in_bits();
+                    }
+                }
+            }
+            return size;
         }
     };
 
@@ -85,6 +135,57 @@ namespace ringsnark::rinocchio {
         }
     };
 
+    /**
+     * A verification key with the parts of the verification that only depend on the circuit precomputed:
+     * the evaluations of the vanishing polynomial and of the QRP polynomials of the constant and primary input
+     * variables at s, and a decoder whose decryptors are reused across proofs.
+     */
+    template<typename RingT, typename EncT>
+    class processed_verification_key : public ringsnark::processed_verification_key<RingT, EncT> {
+        using SecretKey = typename EncT::SecretKey;
+        using Decoder = typename EncT::Decoder;
+
+    public:
+        const RingT alpha;
+        const RingT beta;
+        const RingT r_v, r_w, r_y;
+        const RingT Zt;
+        // {A_j(s)}_{j=0}^{num_inputs}, {B_j(s)}_{j=0}^{num_inputs}, {C_j(s)}_{j=0}^{num_inputs}, where j = 0 is the
+        // constant variable
+        const vector<RingT> At_io, Bt_io, Ct_io;
+        const SecretKey sk_enc;
+        const std::shared_ptr<const Decoder> decoder;
+
+        processed_verification_key(RingT alpha, RingT beta, RingT r_v, RingT r_w, RingT r_y, RingT Zt,
+                                   vector<RingT> At_io, vector<RingT> Bt_io, vector<RingT> Ct_io,
+                                   SecretKey sk_enc, const bool check_noise_budget = true) :
+                alpha(std::move(alpha)), beta(std::move(beta)),
+                r_v(std::move(r_v)), r_w(std::move(r_w)), r_y(std::move(r_y)),
+                Zt(std::move(Zt)),
+                At_io(std::move(At_io)), Bt_io(std::move(Bt_io)), Ct_io(std::move(Ct_io)),
+                sk_enc(std::move(sk_enc)),
+                decoder(std::make_shared<const Decoder>(this->sk_enc, check_noise_budget)) {
+            assert(this->Bt_io.size() == this->At_io.size());
+            assert(this->Ct_io.size() == this->At_io.size());
+        }
+
+        [[nodiscard]] size_t num_inputs() const {
+            return At_io.size() - 1;
+        }
+
+        [[nodiscard]] size_t size_in_bits() const override {
+            size_t size = alpha.size_in_bits() + beta.size_in_bits() +
+                          r_v.size_in_bits() + r_w.size_in_bits() + r_y.size_in_bits() + Zt.size_in_bits() +
+                          EncT::size_in_bits_sk(sk_enc);
+            for (const auto *vals: {&At_io, &Bt_io, &Ct_io}) {
+                for (const auto &val: *vals) {
+                    size += val.size_in_bits();
+                }
+            }
+            return size;
+        }
+    };
+
     template<typename RingT, typename EncT>
     class keypair {
     public:
@@ -1,12 +1,54 @@
 #include <ringsnark/reductions/r1cs_to_qrp/r1cs_to_qrp.hpp>
+#include <ringsnark/util/parallel.hpp>
+#include <tuple>
 
 namespace ringsnark::rinocchio {
+    /**
+     * Set up the encoding contexts of EncT with the smallest parameters that leave enough noise budget for proofs
+     * about cs (see EncodingElem::set_context), instead of a fixed choice. packed must match the flag passed to
+     * the generator.
+     */
     template<typename RingT, typename EncT>
-    keypair<RingT, EncT> generator(const r1cs_constraint_system<RingT> &cs) {
+    void set_encoding_context(const r1cs_constraint_system<RingT> &cs, const bool packed = false) {
+        // A/B/C add up d products with the mid basis, and the d+1 products in Z scaled once more by d_1, d_2, d_3;
+        // F adds up the auxiliary products and three shift terms
+        const size_t d = r1cs_to_qrp_degree(cs);
+        EncT::set_context(std::max(2 * d + 1, cs.auxiliary_input_size + 3), 2, packed);
+    }
+
+    /**
+     * If lagrange_basis is set, the proving key also holds {E(L_i(s))}, {E(alpha * L_i(s))} for the Lagrange polynomials
+     * L_i of the QRP domain. This makes the key larger, but lets the prover skip interpolating the A/B/C polynomials.
+     *
+     * If packed is set, the vectors in the proving key are encoded in packed form (see EncT::encode_packed), which
+     * shrinks them by the packing factor of EncT and lets the prover compute its inner products with correspondingly
+     * fewer multiplications. The proving key then also holds the keys to fold the packed inner products, which for
+     * EncodingElem are Galois keys, i.e., encryptions of the automorphisms of the secret key.
+     *
+     * If legacy_layout is set, the proving key also holds {E(alpha * r_* * Z(s))} and {E(r_* * *_i(s))}, which the
+     * prover does not read, but which earlier versions of the key included. This takes three more encodings of
+     * vectors of the size of the auxiliary input.
+     *
+     * The per-variable terms and their encodings are computed on up to num_threads threads.
+     *
+     * If keep_seeded is set, the encodings of the proving key keep their seed-compressed form (see
+     * EncT::encode), so that saving the keys writes about half the bytes. Set it only if the keys are saved.
+     */
+    template<typename RingT, typename EncT>
+    keypair<RingT, EncT> generator(const r1cs_constraint_system<RingT> &cs, const bool lagrange_basis = false,
+                                   const bool packed = false, const bool legacy_layout = false,
+                                   const size_t num_threads = 1, const bool keep_seeded = false) {
         const RingT s = RingT::random_exceptional_element();
         const qrp_instance_evaluation<RingT> qrp_inst = r1cs_to_qrp_instance_map_with_evaluation(cs, s);
 
-        const auto [pk_enc, sk_enc] = EncT::keygen();
+        const auto [pk_enc, sk_enc] = EncT::keygen(packed);
+        const auto encode_vector = [&sk = sk_enc, packed, num_threads, keep_seeded](const vector<RingT> &rs) {
+            return packed ? EncT::encode_packed(sk, rs, num_threads, keep_seeded)
+                          : EncT::encode(sk, rs, num_threads, keep_seeded);
+        };
+        const auto encode = [&sk = sk_enc, keep_seeded](const RingT &r) {
+            return EncT::encode(sk, {r}, 1, keep_seeded)[0];
+        };
 
         const RingT alpha = RingT::random_invertible_element(),
                 r_v = RingT::random_invertible_element(),
@@ -17,50 +59,70 @@ namespace ringsnark::rinocchio {
         // ({E(s^i)}_{i=0}^{num_mid}}, {E(alpha * s^i)}_{i=0}^{num_mid}}, {beta_prod}_{i=0}^{num_mid}, pk)
         // Ht holds the monomials {s^i}_{i=0}^m
 
-        vector<RingT> s_pows_ring(qrp_inst.Ht.begin(), qrp_inst.Ht.begin() + cs.num_constraints() + 1);
+        vector<RingT> s_pows_ring(qrp_inst.Ht.begin(), qrp_inst.Ht.begin() + qrp_inst.degree() + 1);
         vector<RingT> alpha_s_pows_ring(s_pows_ring);
-        for (auto &s_i: alpha_s_pows_ring) { s_i *= alpha; }
-
-        vector<RingT> linchecks, rv_vs, rw_ws, ry_ys;
-        linchecks.reserve(cs.auxiliary_input_size);
-        rv_vs.reserve(cs.auxiliary_input_size);
-        rw_ws.reserve(cs.auxiliary_input_size);
-        ry_ys.reserve(cs.auxiliary_input_size);
-        for (size_t i = 0; i < cs.auxiliary_input_size; i++) {
+        parallel_for(alpha_s_pows_ring.size(), num_threads, [&](const size_t i) { alpha_s_pows_ring[i] *= alpha; });
+
+        vector<RingT> linchecks(cs.auxiliary_input_size), rv_vs, rw_ws, ry_ys;
+        if (legacy_layout) {
+            rv_vs.resize(cs.auxiliary_input_size);
+            rw_ws.resize(cs.auxiliary_input_size);
+            ry_ys.resize(cs.auxiliary_input_size);
+        }
+        parallel_for(cs.auxiliary_input_size, num_threads, [&](const size_t i) {
             size_t idx = i + cs.primary_input_size + 1;
-            rv_vs.push_back(r_v * qrp_inst.At[idx]);
-            rw_ws.push_back(r_w * qrp_inst.Bt[idx]);
-            ry_ys.push_back(r_y * qrp_inst.Ct[idx]);
+            RingT rv_v = r_v * qrp_inst.At[idx], rw_w = r_w * qrp_inst.Bt[idx], ry_y = r_y * qrp_inst.Ct[idx];
 
-            RingT lincheck(rv_vs[i]);
-            lincheck += rw_ws[i];
-            lincheck += ry_ys[i];
+            RingT &lincheck = linchecks[i];
+            lincheck = rv_v;
+            lincheck += rw_w;
+            lincheck += ry_y;
             lincheck *= beta;
-            linchecks.push_back(lincheck);
-        }
 
-        const vector<EncT> s_pows = EncT::encode(sk_enc, s_pows_ring),
-                alpha_s_pows = EncT::encode(sk_enc, alpha_s_pows_ring),
-                beta_prods = EncT::encode(sk_enc, linchecks);
+            if (legacy_layout) {
+                rv_vs[i] = std::move(rv_v);
+                rw_ws[i] = std::move(rw_w);
+                ry_ys[i] = std::move(ry_y);
+            }
+        });
+
+        const vector<EncT> s_pows = encode_vector(s_pows_ring),
+                alpha_s_pows = encode_vector(alpha_s_pows_ring),
+                beta_prods = encode_vector(linchecks);
 
         const RingT beta_Zt = beta * qrp_inst.Zt;
-        const EncT beta_rv_ts = EncT::encode(sk_enc, {beta_Zt * r_v})[0];
-        const EncT beta_rw_ts = EncT::encode(sk_enc, {beta_Zt * r_w})[0];
-        const EncT beta_ry_ts = EncT::encode(sk_enc, {beta_Zt * r_y})[0];
+        const EncT beta_rv_ts = encode(beta_Zt * r_v);
+        const EncT beta_rw_ts = encode(beta_Zt * r_w);
+        const EncT beta_ry_ts = encode(beta_Zt * r_y);
+
+        std::optional<EncT> alpha_rv_ts, alpha_rw_ts, alpha_ry_ts;
+        if (legacy_layout) {
+            const RingT alpha_Zt = alpha * qrp_inst.Zt;
+            alpha_rv_ts = encode(alpha_Zt * r_v);
+            alpha_rw_ts = encode(alpha_Zt * r_w);
+            alpha_ry_ts = encode(alpha_Zt * r_y);
+        }
 
-        const RingT alpha_Zt = alpha * qrp_inst.Zt;
-        const EncT alpha_rv_ts = EncT::encode(sk_enc, {alpha_Zt * r_v})[0];
-        const EncT alpha_rw_ts = EncT::encode(sk_enc, {alpha_Zt * r_w})[0];
-        const EncT alpha_ry_ts = EncT::encode(sk_enc, {alpha_Zt * r_y})[0];
+        vector<EncT> lagrange_s, alpha_lagrange_s;
+        if (lagrange_basis) {
+            vector<RingT> lagrange_s_ring = qrp_inst.domain->evaluate_all_lagrange_polynomials(s);
+            vector<RingT> alpha_lagrange_s_ring(lagrange_s_ring);
+            parallel_for(alpha_lagrange_s_ring.size(), num_threads,
+                         [&](const size_t i) { alpha_lagrange_s_ring[i] *= alpha; });
+            lagrange_s = encode_vector(lagrange_s_ring);
+            alpha_lagrange_s = encode_vector(alpha_lagrange_s_ring);
+        }
 
         // pk = ({E(s^i)}_{i=0}^{num_mid}}, {E(alpha * s^i)}_{i=0}^{num_mid}}, {beta_prod}_{i=0}^{num_mid}, pk_enc)
         auto pk = new proving_key<RingT, EncT>(cs, s_pows, alpha_s_pows, beta_prods,
                                                beta_rv_ts, beta_rw_ts, beta_ry_ts,
                                                alpha_rv_ts, alpha_rw_ts, alpha_ry_ts,
-                                               EncT::encode(sk_enc, rv_vs),
-                                               EncT::encode(sk_enc, rw_ws),
-                                               EncT::encode(sk_enc, ry_ys),
-                                               pk_enc);
+                                               encode_vector(rv_vs),
+                                               encode_vector(rw_ws),
+                                               encode_vector(ry_ys),
+                                               pk_enc,
+                                               lagrange_s, alpha_lagrange_s,
+                                               packed);
 
         // vk = (pk, s, alpha, beta, r_v, r_w, r_y, sk_enc)
         auto vk = new verification_key<RingT, EncT>(*pk, s, alpha, beta, r_v, r_w, r_y, sk_enc);
@@ -68,10 +130,14 @@ namespace ringsnark::rinocchio {
         return ::ringsnark::rinocchio::keypair<RingT, EncT>(*pk, *vk);
     }
 
+    /**
+     * The encoded inner products of the proof are computed on up to num_threads threads.
+     */
     template<typename RingT, typename EncT>
     proof<RingT, EncT> prover(const proving_key<RingT, EncT> &pk,
                               const r1cs_primary_input<RingT> &primary_input,
-                              const r1cs_auxiliary_input<RingT> &auxiliary_input) {
+                              const r1cs_auxiliary_input<RingT> &auxiliary_input,
+                              const size_t num_threads = 1) {
 #ifdef DEBUG
         assert(pk.constraint_system.is_satisfied(primary_input, auxiliary_input));
 #endif
@@ -84,53 +150,70 @@ namespace ringsnark::rinocchio {
         const RingT d3 = use_zk ? RingT::random_invertible_element() : RingT::zero();
 
 
+        // With a Lagrange-basis key, A/B/C_mid are paired with {E(L_i(s))} as evaluations on the domain,
+        // so the witness map does not need to interpolate them
+        const bool lagrange_basis = pk.has_lagrange_basis();
         const qrp_witness<RingT> qrp_wit = r1cs_to_qrp_witness_map(pk.constraint_system,
                                                                    primary_input, auxiliary_input,
-                                                                   d1, d2, d3);
-
-        // TODO: this is highly non-optimized, skip all the zero-multiplication
-        // s_pows, alpha_s_pows have length d+1, where d = cs.num_constraints() is the size of the QRP
-        const auto a_mid = qrp_wit.coefficients_for_A_mid;
-        EncT a_enc = inner_product<EncT, RingT>(pk.s_pows.begin(), pk.s_pows.end() - 1,
-                                                a_mid.begin(), a_mid.end());
-        EncT alpha_a_enc = inner_product<EncT, RingT>(pk.alpha_s_pows.begin(), pk.alpha_s_pows.end() - 1,
-                                                      a_mid.begin(), a_mid.end());
-
-        const auto b_mid = qrp_wit.coefficients_for_B_mid;
-        EncT b_enc = inner_product<EncT, RingT>(pk.s_pows.begin(), pk.s_pows.end() - 1,
-                                                b_mid.begin(), b_mid.end());
-        EncT alpha_b_enc = inner_product<EncT, RingT>(pk.alpha_s_pows.begin(), pk.alpha_s_pows.end() - 1,
-                                                      b_mid.begin(), b_mid.end());
-
-        const auto c_mid = qrp_wit.coefficients_for_C_mid;
-        EncT c_enc = inner_product<EncT, RingT>(pk.s_pows.begin(), pk.s_pows.end() - 1,
-                                                c_mid.begin(), c_mid.end());
-        EncT alpha_c_enc = inner_product<EncT, RingT>(pk.alpha_s_pows.begin(), pk.alpha_s_pows.end() - 1,
-                                                      c_mid.begin(), c_mid.end());
-
-        const auto z = qrp_wit.coefficients_for_Z;
-        EncT z_enc = inner_product<EncT, RingT>(pk.s_pows.begin(), pk.s_pows.end(),
-                                                z.begin(), z.end());
-        EncT alpha_z_enc = inner_product<EncT, RingT>(pk.alpha_s_pows.begin(), pk.alpha_s_pows.end(),
-                                                      z.begin(), z.end());
+                                                                   d1, d2, d3, lagrange_basis);
+
+        // s_pows, alpha_s_pows hold d+1 elements, where d is the degree of the QRP;
+        // in a packed key, the first n elements of each vector are held by the first pk.num_encodings(n) encodings
+        const size_t d = qrp_wit.degree();
+        const size_t num_mid = pk.num_encodings(d), num_pows = pk.num_encodings(d + 1),
+                num_aux = pk.num_encodings(auxiliary_input.size());
+        const vector<EncT> &mid_basis = lagrange_basis ? pk.lagrange_s : pk.s_pows;
+        const vector<EncT> &alpha_mid_basis = lagrange_basis ? pk.alpha_lagrange_s : pk.alpha_s_pows;
+        const auto &a_mid = qrp_wit.coefficients_for_A_mid;
+        const auto &b_mid = qrp_wit.coefficients_for_B_mid;
+        const auto &c_mid = qrp_wit.coefficients_for_C_mid;
+        const auto &z = qrp_wit.coefficients_for_Z;
+        const auto &h = qrp_wit.coefficients_for_H;
+
+        // The inner products are independent, so they are spread across the threads, and each gets an equal share of
+        // the threads for its own chunks. Inner products with the same coefficients are computed together, so that
+        // each coefficient is prepared for multiplication only once.
+        using enc_range = std::pair<typename vector<EncT>::const_iterator, typename vector<EncT>::const_iterator>;
+        const vector<std::pair<vector<enc_range>, const vector<RingT> *>> inner_products = {
+                {{{mid_basis.begin(), mid_basis.begin() + num_mid},
+                         {alpha_mid_basis.begin(), alpha_mid_basis.begin() + num_mid}}, &a_mid},
+                {{{mid_basis.begin(), mid_basis.begin() + num_mid},
+                         {alpha_mid_basis.begin(), alpha_mid_basis.begin() + num_mid}}, &b_mid},
+                {{{mid_basis.begin(), mid_basis.begin() + num_mid},
+                         {alpha_mid_basis.begin(), alpha_mid_basis.begin() + num_mid}}, &c_mid},
+                {{{pk.s_pows.begin(), pk.s_pows.begin() + num_pows},
+                         {pk.alpha_s_pows.begin(), pk.alpha_s_pows.begin() + num_pows}}, &z},
+                {{{pk.s_pows.begin(), pk.s_pows.begin() + num_pows},
+                         {pk.alpha_s_pows.begin(), pk.alpha_s_pows.begin() + num_pows}}, &h},
+                {{{pk.beta_prods.begin(), pk.beta_prods.begin() + num_aux}}, &auxiliary_input},
+        };
+        const size_t outer_threads = std::min(num_threads, inner_products.size());
+        const size_t inner_threads = std::max<size_t>(1, num_threads / outer_threads);
+        vector<vector<EncT>> res(inner_products.size());
+        parallel_for(inner_products.size(), outer_threads, [&](const size_t i) {
+            const auto &[as, b] = inner_products[i];
+            res[i] = pk.packed
+                     ? packed_inner_products<EncT, RingT>(as, b->begin(), b->end(), pk.pk_enc, inner_threads)
+                     : ringsnark::inner_products<EncT, RingT>(as, b->begin(), b->end(), inner_threads);
+        });
+        EncT &a_enc = res[0][0], &alpha_a_enc = res[0][1],
+                &b_enc = res[1][0], &alpha_b_enc = res[1][1],
+                &c_enc = res[2][0], &alpha_c_enc = res[2][1],
+                &z_enc = res[3][0], &alpha_z_enc = res[3][1],
+                &d_enc = res[4][0], &alpha_d_enc = res[4][1],
+                &f_enc = res[5][0];
 
         // Add shift terms
         // TODO: add terms to coefficients_for_{A, B, C} directly, similarly to H
-        a_enc += d1 * z_enc;
-        alpha_a_enc += d1 * alpha_z_enc;
-        b_enc += d2 * z_enc;
-        alpha_b_enc += d2 * alpha_z_enc;
-        c_enc += d3 * z_enc;
-        alpha_c_enc += d3 * alpha_z_enc;
-
-        const auto h = qrp_wit.coefficients_for_H;
-        EncT d_enc = inner_product<EncT, RingT>(pk.s_pows.begin(), pk.s_pows.end(),
-                                                h.begin(), h.end());
-        EncT alpha_d_enc = inner_product<EncT, RingT>(pk.alpha_s_pows.begin(), pk.alpha_s_pows.end(),
-                                                      h.begin(), h.end());
-
-        EncT f_enc = inner_product<EncT, RingT>(pk.beta_prods.begin(), pk.beta_prods.end(),
-                                                auxiliary_input.begin(), auxiliary_input.end());
+        const vector<std::tuple<EncT *, const RingT *, const EncT *>> shifts = {
+                {&a_enc, &d1, &z_enc}, {&alpha_a_enc, &d1, &alpha_z_enc},
+                {&b_enc, &d2, &z_enc}, {&alpha_b_enc, &d2, &alpha_z_enc},
+                {&c_enc, &d3, &z_enc}, {&alpha_c_enc, &d3, &alpha_z_enc},
+        };
+        parallel_for(shifts.size(), num_threads, [&shifts](const size_t i) {
+            const auto &[target, d_i, shift] = shifts[i];
+            *target += *d_i * *shift;
+        });
         f_enc += d1 * pk.beta_rv_ts;
         f_enc += d2 * pk.beta_rw_ts;
         f_enc += d3 * pk.beta_ry_ts;
@@ -142,89 +225,335 @@ namespace ringsnark::rinocchio {
                                                         f_enc);
     }
 
+    /**
+     * Precompute the parts of the verification that only depend on vk, for verifying many proofs with
+     * online_verifier. If check_noise_budget is set, verification throws when a proof element has run out of noise
+     * budget; otherwise, such a proof is simply rejected.
+     */
     template<typename RingT, typename EncT>
-    bool verifier(const verification_key<RingT, EncT> &vk,
-                  const r1cs_primary_input<RingT> &primary_input,
-                  const proof<RingT, EncT> &proof) {
-        const RingT V_mid = EncT::decode(vk.sk_enc, proof.A),
-                V_mid_prime = EncT::decode(vk.sk_enc, proof.A_prime),
-                W_mid = EncT::decode(vk.sk_enc, proof.B),
-                W_mid_prime = EncT::decode(vk.sk_enc, proof.B_prime),
-                Y_mid = EncT::decode(vk.sk_enc, proof.C),
-                Y_mid_prime = EncT::decode(vk.sk_enc, proof.C_prime),
-                H = EncT::decode(vk.sk_enc, proof.D),
-                H_prime = EncT::decode(vk.sk_enc, proof.D_prime),
-                L_beta = EncT::decode(vk.sk_enc, proof.F);
-        // TODO: define one version that is amenable to parallelization (close to current implementation), and an "online" version that re-uses the same object in a decode-check loop
-
-        const auto cs = vk.pk.constraint_system;
-
-        qrp_instance_evaluation<RingT> qrp_inst_eval = r1cs_to_qrp_instance_map_with_evaluation(cs, vk.s);
-
-        // L = beta * ((vk.r_v * V_mid) + (vk.r_w * W_mid) + (vk.r_y * Y_mid))
-        RingT L = V_mid * vk.r_v;
-        L += W_mid * vk.r_w;
-        L += Y_mid * vk.r_y;
-        L *= vk.beta;
-
-        // TODO: make this more efficient, and skip all zero-mults
-        vector<RingT> padded_primary_assignment(primary_input);
-        vector<RingT> zeros(vk.pk.constraint_system.auxiliary_input_size, RingT::zero());
-        padded_primary_assignment.insert(padded_primary_assignment.end(), zeros.begin(), zeros.end());
-        // TODO: or use the {At, Bt, Ct} members from qrp_inst_eval?
-        vector<RingT> v_io(cs.num_constraints()), w_io(cs.num_constraints()), y_io(cs.num_constraints());
-        for (size_t i = 0; i < cs.num_constraints(); ++i) {
-            v_io[i] = cs.constraints[i].a.evaluate(padded_primary_assignment);
-            w_io[i] = cs.constraints[i].b.evaluate(padded_primary_assignment);
-            y_io[i] = cs.constraints[i].c.evaluate(padded_primary_assignment);
-        }
-        auto domain = get_evaluation_domain<RingT>(cs.num_constraints());
-        vector<RingT> xs(domain->m);
-        for (size_t i = 0; i < domain->m; i++) { xs[i] = domain->get_domain_element(i); }
-        v_io = interpolate(xs, v_io);
-        w_io = interpolate(xs, w_io);
-        y_io = interpolate(xs, y_io);
-
-        auto v_io_s = eval(v_io, vk.s);
-        auto w_io_s = eval(w_io, vk.s);
-        auto y_io_s = eval(y_io, vk.s);
-
-        // P = (v_io(s) + V_mid) * (w_io(s) + W_mid) - (y_io(s) + Y_mid)
-        RingT P = V_mid + v_io_s;
-        P *= W_mid + w_io_s;
-        P -= Y_mid + y_io_s;
-
-        RingT tmp;
+    processed_verification_key<RingT, EncT> verifier_process_vk(const verification_key<RingT, EncT> &vk,
+                                                                const bool check_noise_budget = true) {
+        const auto &cs = vk.pk.constraint_system;
+        const qrp_instance_evaluation<RingT> qrp_inst_eval = r1cs_to_qrp_instance_map_with_evaluation(cs, vk.s);
+
+        // The IO polynomials are v_io(z) = sum_i L_i(z) * a_i(x), for the io part a_i(x) of the i-th constraint,
+        // so that v_io(s) = A_0(s) + sum_j x_j * A_j(s), and likewise for w_io, y_io
+        const size_t num_io = cs.num_inputs() + 1;
+        return processed_verification_key<RingT, EncT>(vk.alpha, vk.beta, vk.r_v, vk.r_w, vk.r_y, qrp_inst_eval.Zt,
+                                                       vector<RingT>(qrp_inst_eval.At.begin(),
+                                                                     qrp_inst_eval.At.begin() + num_io),
+                                                       vector<RingT>(qrp_inst_eval.Bt.begin(),
+                                                                     qrp_inst_eval.Bt.begin() + num_io),
+                                                       vector<RingT>(qrp_inst_eval.Ct.begin(),
+                                                                     qrp_inst_eval.Ct.begin() + num_io),
+                                                       vk.sk_enc, check_noise_budget);
+    }
+
+    namespace {
+        /**
+         * The decoded elements of a proof, and the left-hand side P of its divisibility check P = H * Z(s).
+         */
+        template<typename RingT>
+        struct decoded_proof {
+            RingT V_mid, V_mid_prime, W_mid, W_mid_prime, Y_mid, Y_mid_prime, H, H_prime, L_beta;
+            RingT P;
+            // Whether the primary input fits the constraint system
+            bool well_formed = true;
+        };
+
+        /**
+         * Decode the proofs, with all their elements spread across up to num_threads threads, and compute their P
+         * from the primary inputs, in one pass over each.
+         */
+        template<typename RingT, typename EncT>
+        vector<decoded_proof<RingT>> decode_proofs(const processed_verification_key<RingT, EncT> &pvk,
+                                                   const vector<const r1cs_primary_input<RingT> *> &primary_inputs,
+                                                   const vector<const proof<RingT, EncT> *> &proofs,
+                                                   const size_t num_threads) {
+            assert(primary_inputs.size() == proofs.size());
+            vector<std::reference_wrapper<const EncT>> es;
+            es.reserve(9 * proofs.size());
+            for (const auto *pi: proofs) {
+                es.insert(es.end(), {pi->A, pi->A_prime, pi->B, pi->B_prime, pi->C, pi->C_prime,
+                                     pi->D, pi->D_prime, pi->F});
+            }
+            const vector<RingT> decoded = pvk.decoder->decode(es, num_threads);
+
+            vector<decoded_proof<RingT>> res(proofs.size());
+            parallel_for(proofs.size(), num_threads, [&](const size_t k) {
+                decoded_proof<RingT> &d = res[k];
+                const RingT *e = &decoded[9 * k];
+                d.V_mid = e[0], d.V_mid_prime = e[1], d.W_mid = e[2], d.W_mid_prime = e[3],
+                d.Y_mid = e[4], d.Y_mid_prime = e[5], d.H = e[6], d.H_prime = e[7], d.L_beta = e[8];
+
+                const r1cs_primary_input<RingT> &primary_input = *primary_inputs[k];
+                if (primary_input.size() > pvk.num_inputs()) {
+                    d.well_formed = false;
+                    return;
+                }
+                RingT v_io_s = pvk.At_io[0], w_io_s = pvk.Bt_io[0], y_io_s = pvk.Ct_io[0];
+                for (size_t j = 0; j < primary_input.size(); j++) {
+                    if (primary_input[j].is_zero()) {
+                        continue;
+                    }
+                    v_io_s += primary_input[j] * pvk.At_io[j + 1];
+                    w_io_s += primary_input[j] * pvk.Bt_io[j + 1];
+                    y_io_s += primary_input[j] * pvk.Ct_io[j + 1];
+                }
+
+                // P = (v_io(s) + V_mid) * (w_io(s) + W_mid) - (y_io(s) + Y_mid)
+                d.P = d.V_mid + v_io_s;
+                d.P *= d.W_mid + w_io_s;
+                d.P -= d.Y_mid + y_io_s;
+            });
+            return res;
+        }
+
+        /**
+         * Run the checks of the verifier on the proofs ds[begin, end). For more than one proof, each check is
+         * applied once to a random linear combination of the proofs, e.g., sum_k rho_k * V'_k = alpha * sum_k rho_k * V_k
+         * for random weights rho_k, which holds for a proof that fails the check with probability at most 1/q,
+         * for the smallest modulus q of the ring.
+         */
+        template<typename RingT, typename EncT>
+        bool check_decoded_proofs(const processed_verification_key<RingT, EncT> &pvk,
+                                  const vector<decoded_proof<RingT>> &ds, const size_t begin, const size_t end) {
+            RingT V_mid = RingT::zero(), V_mid_prime = RingT::zero(), W_mid = RingT::zero(), W_mid_prime = RingT::zero(),
+                    Y_mid = RingT::zero(), Y_mid_prime = RingT::zero(), H = RingT::zero(), H_prime = RingT::zero(),
+                    L_beta = RingT::zero(), P = RingT::zero();
+            for (size_t k = begin; k < end; k++) {
+                const decoded_proof<RingT> &d = ds[k];
+                if (!d.well_formed) {
+                    return false;
+                }
+                if (end - begin == 1) {
+                    V_mid = d.V_mid, V_mid_prime = d.V_mid_prime, W_mid = d.W_mid, W_mid_prime = d.W_mid_prime,
+                    Y_mid = d.Y_mid, Y_mid_prime = d.Y_mid_prime, H = d.H, H_prime = d.H_prime,
+                    L_beta = d.L_beta, P = d.P;
+                    break;
+                }
+                const RingT rho = RingT::random_element();
+                V_mid += rho * d.V_mid;
+                V_mid_prime += rho * d.V_mid_prime;
+                W_mid += rho * d.W_mid;
+                W_mid_prime += rho * d.W_mid_prime;
+                Y_mid += rho * d.Y_mid;
+                Y_mid_prime += rho * d.Y_mid_prime;
+                H += rho * d.H;
+                H_prime += rho * d.H_prime;
+                L_beta += rho * d.L_beta;
+                P += rho * d.P;
+            }
+
+            // L = beta * ((vk.r_v * V_mid) + (vk.r_w * W_mid) + (vk.r_y * Y_mid))
+            RingT L = V_mid * pvk.r_v;
+            L += W_mid * pvk.r_w;
+            L += Y_mid * pvk.r_y;
+            L *= pvk.beta;
+
+            RingT tmp;
+            // CHECK: V'_mid = alpha * V_mid
+            tmp = V_mid * pvk.alpha;
+            bool res = true;
+            if (V_mid_prime != tmp) {
+                res = false;
+            }
+            // CHECK: W'_mid = alpha * W_mid
+            tmp = W_mid * pvk.alpha;
+            if (W_mid_prime != tmp) {
+                res = false;
+            }
+            // CHECK: Y'_mid = alpha * Y_mid
+            tmp = Y_mid * pvk.alpha;
+            if (Y_mid_prime != tmp) {
+                res = false;
+            }
+            // CHECK: H' = alpha * H
+            tmp = H * pvk.alpha;
+            if (H_prime != tmp) {
+                res = false;
+            }
+            // CHECK: L_beta = L
+            if (L != L_beta) {
+                res = false;
+            }
+
+            tmp = H * pvk.Zt;
+            if (P != tmp) {
+                res = false;
+            }
+            return res;
+        }
+
+        template<typename T>
+        vector<const T *> pointers_to(const vector<T> &vec) {
+            vector<const T *> res;
+            res.reserve(vec.size());
+            for (const T &t: vec) {
+                res.push_back(&t);
+            }
+            return res;
+        }
+    }
+
+    /**
+     * Verify a proof with a processed verification key, in one pass over the primary input plus the decoding of
+     * the proof elements. A primary input shorter than the one of the constraint system is padded with zeros.
+     *
+     * The verifier decodes the proof in a decode-check loop: each check runs as soon as the elements it needs are
+     * decoded, e.g., V'_mid = alpha * V_mid right after A and A', and the first failing check rejects the proof
+     * without decoding the rest. The limbs of each element are decoded on up to num_threads threads, and at most six
+     * ring elements are alive at any time: V_mid, W_mid, Y_mid, H, and two scratch elements.
+     */
+    template<typename RingT, typename EncT>
+    bool online_verifier(const processed_verification_key<RingT, EncT> &pvk,
+                         const r1cs_primary_input<RingT> &primary_input,
+                         const proof<RingT, EncT> &proof,
+                         const size_t num_threads = 1) {
+        if (primary_input.size() > pvk.num_inputs()) {
+            return false;
+        }
+        const auto &decoder = *pvk.decoder;
+        RingT V_mid, W_mid, Y_mid, H, scratch, tmp;
+
         // CHECK: V'_mid = alpha * V_mid
-        tmp = V_mid * vk.alpha;
-        bool res = true;
-        if (V_mid_prime != tmp) {
-            res = false;
+        decoder.decode(proof.A, V_mid, num_threads);
+        decoder.decode(proof.A_prime, scratch, num_threads);
+        tmp = V_mid * pvk.alpha;
+        if (scratch != tmp) {
+            return false;
         }
         // CHECK: W'_mid = alpha * W_mid
-        tmp = W_mid * vk.alpha;
-        if (W_mid_prime != tmp) {
-            res = false;
+        decoder.decode(proof.B, W_mid, num_threads);
+        decoder.decode(proof.B_prime, scratch, num_threads);
+        tmp = W_mid * pvk.alpha;
+        if (scratch != tmp) {
+            return false;
         }
         // CHECK: Y'_mid = alpha * Y_mid
-        tmp = Y_mid * vk.alpha;
-        if (Y_mid_prime != tmp) {
-            res = false;
+        decoder.decode(proof.C, Y_mid, num_threads);
+        decoder.decode(proof.C_prime, scratch, num_threads);
+        tmp = Y_mid * pvk.alpha;
+        if (scratch != tmp) {
+            return false;
+        }
+        // CHECK: L_beta = beta * ((vk.r_v * V_mid) + (vk.r_w * W_mid) + (vk.r_y * Y_mid))
+        decoder.decode(proof.F, scratch, num_threads);
+        tmp = V_mid * pvk.r_v;
+        tmp += W_mid * pvk.r_w;
+        tmp += Y_mid * pvk.r_y;
+        tmp *= pvk.beta;
+        if (scratch != tmp) {
+            return false;
         }
         // CHECK: H' = alpha * H
-        tmp = H * vk.alpha;
-        if (H_prime != tmp) {
-            res = false;
+        decoder.decode(proof.D, H, num_threads);
+        decoder.decode(proof.D_prime, scratch, num_threads);
+        tmp = H * pvk.alpha;
+        if (scratch != tmp) {
+            return false;
         }
-        // CHECK: L_beta = L
-        if (L != L_beta) {
-            res = false;
+
+        // CHECK: (v_io(s) + V_mid) * (w_io(s) + W_mid) - (y_io(s) + Y_mid) = H * Z(s),
+        // accumulating the IO terms into V_mid, W_mid and Y_mid, which are no longer needed on their own
+        V_mid += pvk.At_io[0];
+        W_mid += pvk.Bt_io[0];
+        Y_mid += pvk.Ct_io[0];
+        for (size_t j = 0; j < primary_input.size(); j++) {
+            if (primary_input[j].is_zero()) {
+                continue;
+            }
+            V_mid += primary_input[j] * pvk.At_io[j + 1];
+            W_mid += primary_input[j] * pvk.Bt_io[j + 1];
+            Y_mid += primary_input[j] * pvk.Ct_io[j + 1];
         }
+        V_mid *= W_mid;
+        V_mid -= Y_mid;
+        tmp = H * pvk.Zt;
+        return V_mid == tmp;
+    }
 
-        tmp = H * qrp_inst_eval.Zt;
-        if (P != tmp) {
-            res = false;
+    /**
+     * Verify several proofs under the same verification key at once, and accept iff all of them are accepted, up to
+     * a soundness error of 1/q for the smallest modulus q of the ring (see check_decoded_proofs).
+     *
+     * The proofs are decoded on up to num_threads threads, and each check of the verifier, e.g., the one comparing
+     * with H * Z(s), is then done once for a random linear combination of the proofs.
+     * If the batch is rejected, find_invalid_proofs finds the proofs to blame.
+     */
+    template<typename RingT, typename EncT>
+    bool batch_verifier(const processed_verification_key<RingT, EncT> &pvk,
+                        const vector<r1cs_primary_input<RingT>> &primary_inputs,
+                        const vector<proof<RingT, EncT>> &proofs,
+                        const size_t num_threads = 1) {
+        if (primary_inputs.size() != proofs.size()) {
+            throw std::invalid_argument("expected one primary input per proof");
         }
-        return res;
+        if (proofs.empty()) {
+            return true;
+        }
+        const auto ds = decode_proofs(pvk, pointers_to(primary_inputs), pointers_to(proofs), num_threads);
+        return check_decoded_proofs(pvk, ds, 0, ds.size());
+    }
+
+    template<typename RingT, typename EncT>
+    bool batch_verifier(const verification_key<RingT, EncT> &vk,
+                        const vector<r1cs_primary_input<RingT>> &primary_inputs,
+                        const vector<proof<RingT, EncT>> &proofs,
+                        const size_t num_threads = 1,
+                        const bool check_noise_budget = true) {
+        return batch_verifier(verifier_process_vk(vk, check_noise_budget), primary_inputs, proofs, num_threads);
+    }
+
+    /**
+     * Return the indices of the proofs that the verifier rejects, in increasing order.
+     *
+     * The proofs are decoded once, and the batched checks of batch_verifier are applied to halves of the rejected
+     * ranges until single proofs remain, which are checked exactly. With few invalid proofs, this takes about
+     * 2 * log(n) batched checks per invalid proof, instead of n checks.
+     */
+    template<typename RingT, typename EncT>
+    vector<size_t> find_invalid_proofs(const processed_verification_key<RingT, EncT> &pvk,
+                                       const vector<r1cs_primary_input<RingT>> &primary_inputs,
+                                       const vector<proof<RingT, EncT>> &proofs,
+                                       const size_t num_threads = 1) {
+        if (primary_inputs.size() != proofs.size()) {
+            throw std::invalid_argument("expected one primary input per proof");
+        }
+        vector<size_t> invalid;
+        if (proofs.empty()) {
+            return invalid;
+        }
+        const auto ds = decode_proofs(pvk, pointers_to(primary_inputs), pointers_to(proofs), num_threads);
+
+        vector<std::pair<size_t, size_t>> ranges = {{0, ds.size()}};
+        while (!ranges.empty()) {
+            const auto [begin, end] = ranges.back();
+            ranges.pop_back();
+            if (check_decoded_proofs(pvk, ds, begin, end)) {
+                continue;
+            }
+            if (end - begin == 1) {
+                invalid.push_back(begin);
+                continue;
+            }
+            // Push the right half first, so that the left half is checked first and invalid is sorted
+            const size_t mid = begin + (end - begin) / 2;
+            ranges.emplace_back(mid, end);
+            ranges.emplace_back(begin, mid);
+        }
+        return invalid;
+    }
+
+    /**
+     * Verify a proof with a non-processed verification key (see verifier_process_vk and online_verifier).
+     */
+    template<typename RingT, typename EncT>
+    bool verifier(const verification_key<RingT, EncT> &vk,
+                  const r1cs_primary_input<RingT> &primary_input,
+                  const proof<RingT, EncT> &proof,
+                  const size_t num_threads = 1,
+                  const bool check_noise_budget = true) {
+        return online_verifier(verifier_process_vk(vk, check_noise_budget), primary_input, proof, num_threads);
     }
 }
\ No newline at end of file